@@ -0,0 +1,147 @@
+/*
+ * bench_ds3231.cpp
+ *
+ * Compares the cost of reading the time through the virtual driver layout used by
+ * i2c_device/i2c_device_ds3231 with the template driver (ds3231.h). Both run over the
+ * in-memory register file so the numbers show the call overhead and not the bus.
+ * The legacy classes below reproduce the shape of i2c_device_ds3231: a virtual register
+ * read in the base class and virtual getters that read the hours/date/month/year
+ * registers several times.
+ * legacy_pattern_ds3231 issues exactly the same register reads as legacy_ds3231 through the
+ * template path (tmpl::i2c_device, nothing virtual), so the first two rows differ only by the
+ * devirtualization and inlining; the third row adds the fewer reads of tmpl::ds3231.
+ *
+ * The snapshot rows include the three clock_gettime() calls used to anchor the read.
+ *
+ * build: g++ -O2 -std=c++11 bench_ds3231.cpp i2c_diag.cpp -o bench_ds3231
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ds3231.h"
+#include "rtc_device.h"
+
+using namespace std;
+using namespace i2c;
+
+class legacy_device {
+private:
+	memory_transport bus;
+public:
+	memory_transport& transport() { return bus; }
+	virtual int write(unsigned char value){ return bus.write(&value, 1); }
+	virtual unsigned char readRegister(unsigned int registerAddress){
+		this->write(registerAddress);
+		unsigned char buffer[1];
+		bus.read(buffer, 1);
+		return buffer[0];
+	}
+	virtual ~legacy_device() {}
+};
+
+class legacy_ds3231 : protected legacy_device {
+public:
+	using legacy_device::transport;
+	static unsigned int bcdToDec(unsigned char bcdValue) { return (bcdValue >> 4) * 10 + (bcdValue & 0x0F); }
+	virtual unsigned int getSeconds(){ return bcdToDec(this->readRegister(0x00)); }
+	virtual unsigned int getMinutes(){ return bcdToDec(this->readRegister(0x01)); }
+	virtual unsigned int getHours(){
+		if((this->readRegister(0x02) & 0x40) >> 6)
+			return (this->readRegister(0x02) & 0x0F) + ((this->readRegister(0x02) & 0x10) >> 4) * 10;
+		return (this->readRegister(0x02) & 0x0F) + ((this->readRegister(0x02) & 0x30) >> 4) * 10;
+	}
+	virtual unsigned int getDay(){ return bcdToDec(this->readRegister(0x03)); }
+	virtual unsigned int getDate(){ return (this->readRegister(0x04) & 0x0F) + ((this->readRegister(0x04) & 0x30) >> 4) * 10; }
+	virtual unsigned int getMonth(){ return (this->readRegister(0x05) & 0x0F) + ((this->readRegister(0x05) & 0x10) >> 4) * 10; }
+	virtual int getYear(){
+		int value = (this->readRegister(0x06) & 0x0F) + ((this->readRegister(0x06) & 0xF0) >> 4) * 10;
+		return ((this->readRegister(0x05) & 0x80) >> 7) ? 2100 + value : 2000 + value;
+	}
+};
+
+//the read pattern of legacy_ds3231 over the template device: no virtual calls, same reads
+class legacy_pattern_ds3231 : public tmpl::i2c_device<memory_transport> {
+public:
+	static unsigned int bcdToDec(unsigned char bcdValue) { return (bcdValue >> 4) * 10 + (bcdValue & 0x0F); }
+	unsigned int getSeconds(){ return bcdToDec(this->readRegister(0x00)); }
+	unsigned int getMinutes(){ return bcdToDec(this->readRegister(0x01)); }
+	unsigned int getHours(){
+		if((this->readRegister(0x02) & 0x40) >> 6)
+			return (this->readRegister(0x02) & 0x0F) + ((this->readRegister(0x02) & 0x10) >> 4) * 10;
+		return (this->readRegister(0x02) & 0x0F) + ((this->readRegister(0x02) & 0x30) >> 4) * 10;
+	}
+	unsigned int getDay(){ return bcdToDec(this->readRegister(0x03)); }
+	unsigned int getDate(){ return (this->readRegister(0x04) & 0x0F) + ((this->readRegister(0x04) & 0x30) >> 4) * 10; }
+	unsigned int getMonth(){ return (this->readRegister(0x05) & 0x0F) + ((this->readRegister(0x05) & 0x10) >> 4) * 10; }
+	int getYear(){
+		int value = (this->readRegister(0x06) & 0x0F) + ((this->readRegister(0x06) & 0xF0) >> 4) * 10;
+		return ((this->readRegister(0x05) & 0x80) >> 7) ? 2100 + value : 2000 + value;
+	}
+};
+
+//keeps the compiler from seeing the dynamic type and devirtualizing the calls
+__attribute__((noinline)) static legacy_ds3231* makeLegacy(){ return new legacy_ds3231(); }
+__attribute__((noinline)) static rtc_device* makeErased(){ return new rtc_device_model<tmpl::ds3231<memory_transport> >(); }
+
+static const unsigned char TIME[DS3231_REGISTER_COUNT] = {0x45, 0x59, 0x23, 0x07, 0x31, 0x12, 0x24, 0, 0, 0, 0, 0, 0, 0, 0x1C, 0x00, 0x00, 0x19, 0x40};
+
+template<class Function>
+static double measure(const char *name, long iterations, Function function){
+	unsigned long sink = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(long i=0; i<iterations; i++){
+		sink += function();
+		//the register file may have changed, stops the reads being hoisted out of the loop
+		asm volatile("" : : : "memory");
+	}
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	double ns = chrono::duration<double, nano>(end - start).count() / iterations;
+	cout << left << setw(46) << name << right << setw(8) << fixed << setprecision(2) << ns << " ns/op   (" << sink % 10 << ")" << endl;
+	return ns;
+}
+
+int main(int argc, char *argv[]) {
+	long iterations = (argc > 1) ? atol(argv[1]) : 10000000;
+
+	legacy_ds3231 *legacy = makeLegacy();
+	legacy_pattern_ds3231 pattern;
+	tmpl::ds3231<memory_transport> inlined;
+	rtc_device *erased = makeErased();
+	for(int i=0; i<DS3231_REGISTER_COUNT; i++){
+		legacy->transport().registers[i] = TIME[i];
+		pattern.transport().registers[i] = TIME[i];
+		inlined.transport().registers[i] = TIME[i];
+		static_cast<rtc_device_model<tmpl::ds3231<memory_transport> >*>(erased)->get().transport().registers[i] = TIME[i];
+	}
+
+	cout << "Reading the time and date (" << iterations << " iterations)" << endl;
+	double base = measure("virtual getters (i2c_device_ds3231 layout)", iterations, [&]{
+		return legacy->getYear() + legacy->getMonth() + legacy->getDate() + legacy->getDay()
+			+ legacy->getHours() + legacy->getMinutes() + legacy->getSeconds();
+	});
+	double same = measure("inlined getters, same reads (template path)", iterations, [&]{
+		return pattern.getYear() + pattern.getMonth() + pattern.getDate() + pattern.getDay()
+			+ pattern.getHours() + pattern.getMinutes() + pattern.getSeconds();
+	});
+	double getters = measure("inlined getters (tmpl::ds3231)", iterations, [&]{
+		return inlined.getYear() + inlined.getMonth() + inlined.getDate() + inlined.getDay()
+			+ inlined.getHours() + inlined.getMinutes() + inlined.getSeconds();
+	});
+	rtc_snapshot snapshot;
+	measure("inlined burst snapshot (tmpl::ds3231)", iterations, [&]{
+		inlined.readSnapshot(snapshot);
+		return snapshot.year + snapshot.seconds;
+	});
+	measure("type erased snapshot (rtc_device)", iterations, [&]{
+		erased->readSnapshot(snapshot);
+		return snapshot.year + snapshot.seconds;
+	});
+
+	cout << "speedup from inlining alone (same reads): " << setprecision(1) << base / same << "x" << endl;
+	cout << "speedup of tmpl::ds3231 (inlining and fewer reads): " << base / getters << "x" << endl;
+
+	delete legacy;
+	delete erased;
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * check_eeprom_log.cpp
+ *
+ * Exercises the EEPROM record log without an EEPROM. The AT24C32 is replaced by a subclass
+ * that keeps the memory in RAM and can tear a write: only the first half of the bytes reach
+ * the memory and the write fails, as when power is lost during the write cycle. After every
+ * torn write the log is mounted again from the memory and the latest record of each type
+ * must still be there.
+ *
+ * build: g++ -O2 -std=c++11 check_eeprom_log.cpp eeprom_log.cpp i2c_device_at24c32.cpp i2c_device.cpp i2c_diag.cpp -o check_eeprom_log
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "eeprom_log.h"
+#include "i2c_diag.h"
+
+using namespace i2c;
+
+class memory_at24c32 : public i2c_device_at24c32 {
+public:
+	unsigned char memory[AT24C32_SIZE];
+	unsigned long writes[AT24C32_SIZE / EEPROM_LOG_RECORD_SIZE];
+	bool tearNextWrite;
+
+	memory_at24c32(): i2c_device_at24c32(0) {
+		memset(memory, 0xFF, sizeof(memory));
+		memset(writes, 0, sizeof(writes));
+		tearNextWrite = false;
+	}
+
+	virtual int readMemory(unsigned int address, unsigned char *data, unsigned int number){
+		if(address + number > AT24C32_SIZE) return 1;
+		memcpy(data, memory + address, number);
+		return 0;
+	}
+
+	virtual int writeMemory(unsigned int address, const unsigned char *data, unsigned int number){
+		if(address + number > AT24C32_SIZE) return 1;
+		writes[address / EEPROM_LOG_RECORD_SIZE]++;
+		if(tearNextWrite){
+			tearNextWrite = false;
+			memcpy(memory + address, data, number / 2);
+			return 1;
+		}
+		memcpy(memory + address, data, number);
+		return 0;
+	}
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what){
+	if(!condition){
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+//mount a fresh log from the memory, as after a power cycle, and compare the latest records
+static void checkRecovered(memory_at24c32 &eeprom, unsigned int size, float calibration, int8_t aging, int64_t time){
+	eeprom_log log(eeprom, 0, size);
+	float storedCalibration = 0;
+	int8_t storedAging = 0;
+	int64_t storedTime = 0;
+	check(log.mount() == 0, "mount");
+	check(log.loadCalibration(storedCalibration) == 0 && storedCalibration == calibration, "calibration survives a torn write");
+	check(log.loadAgingOffset(storedAging) == 0 && storedAging == aging, "aging offset survives a torn write");
+	check(log.loadLastGoodTime(storedTime) == 0 && storedTime == time, "last good time survives a torn write");
+}
+
+int main(){
+	//the driver diagnostics are expected here (no bus, torn writes)
+	setDiagnosticSink(NULL);
+
+	//the smallest valid area, so that the writer wraps onto the live records quickly
+	const unsigned int size = (EEPROM_LOG_MAX_TYPES + 2) * EEPROM_LOG_RECORD_SIZE;
+	memory_at24c32 eeprom;
+	eeprom_log log(eeprom, 0, size);
+	check(log.mount() == 0, "mount an erased log");
+
+	float calibration = 1.5f;
+	int8_t aging = -3;
+	int64_t time = 1700000000LL;
+	check(log.saveCalibration(calibration) == 0, "save calibration");
+	check(log.saveAgingOffset(aging) == 0, "save aging offset");
+	check(log.saveLastGoodTime(time) == 0, "save last good time");
+
+	for(int i=1; i<=200; i++){
+		//every append is torn once before it succeeds
+		eeprom.tearNextWrite = true;
+		check(log.saveLastGoodTime(time + i) == 1, "torn write reported");
+		checkRecovered(eeprom, size, calibration, aging, time);
+		check(log.mount() == 0, "remount after a torn write");
+		check(log.saveLastGoodTime(time + i) == 0, "save last good time");
+		time += i;
+
+		//the rarely written types are updated now and then, also with torn writes
+		if(i % 50 == 0){
+			eeprom.tearNextWrite = true;
+			check(log.saveCalibration(calibration + 1) == 1, "torn write reported");
+			checkRecovered(eeprom, size, calibration, aging, time);
+			check(log.mount() == 0, "remount after a torn write");
+			check(log.saveCalibration(++calibration) == 0, "save calibration");
+		}
+	}
+	checkRecovered(eeprom, size, calibration, aging, time);
+
+	unsigned long least = ~0UL, most = 0;
+	for(unsigned int slot=0; slot<size / EEPROM_LOG_RECORD_SIZE; slot++){
+		if(eeprom.writes[slot] < least) least = eeprom.writes[slot];
+		if(eeprom.writes[slot] > most) most = eeprom.writes[slot];
+	}
+	printf("writes per slot: least %lu, most %lu\n", least, most);
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * check_rtc_kernel_device.cpp
+ *
+ * Exercises the kernel RTC backend without an RTC. A stub subclass answers the ioctls through
+ * control() and the device file is a FIFO, so the update interrupt ticks can be written by a
+ * thread in the same format as the kernel driver (count << 8 | RTC_UF). Checks the time
+ * decoding, setting the time, the temperature cache and three ticks through the scheduler.
+ *
+ * build: g++ -O2 -std=c++11 -pthread check_rtc_kernel_device.cpp rtc_kernel_device.cpp rtc_scheduler.cpp i2c_diag.cpp -o check_rtc_kernel_device
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/rtc.h>
+#include <thread>
+#include "rtc_kernel_device.h"
+#include "rtc_scheduler.h"
+
+using namespace i2c;
+
+class stub_rtc : public rtc_kernel_device {
+public:
+	struct rtc_time time;
+	int sets, reads;
+
+	stub_rtc(const char *path): rtc_kernel_device(path) {
+		memset(&time, 0, sizeof(time));
+		sets = reads = 0;
+	}
+
+protected:
+	virtual int control(unsigned long request, void *argument){
+		switch(request){
+			case RTC_RD_TIME: reads++; *static_cast<struct rtc_time*>(argument) = time; return 0;
+			case RTC_SET_TIME: sets++; time = *static_cast<struct rtc_time*>(argument); return 0;
+			case RTC_UIE_ON: case RTC_UIE_OFF: return 0;
+		}
+		return -1;
+	}
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what){
+	printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+	if(!condition) failures++;
+}
+
+static void writeFile(const char *path, const char *text){
+	FILE *output = fopen(path, "w");
+	if(output == NULL) return;
+	fputs(text, output);
+	fclose(output);
+}
+
+int main(){
+	char fifo[] = "/tmp/check_rtcXXXXXX";
+	char temperature[] = "/tmp/check_tempXXXXXX";
+	if(mkdtemp(fifo) == NULL || mkdtemp(temperature) == NULL) return 1;
+	strcat(fifo, "/rtc");
+	strcat(temperature, "/temp1_input");
+	if(mkfifo(fifo, 0600) < 0) return 1;
+
+	//the writer side of the FIFO stands in for the update interrupt
+	std::thread interrupts([&]{
+		int file = open(fifo, O_WRONLY);
+		usleep(200000);
+		for(int i=0; i<3; i++){
+			usleep(100000);
+			unsigned long data = (1UL << 8) | RTC_UF;
+			if(write(file, &data, sizeof(data)) != sizeof(data)) break;
+		}
+		usleep(200000);
+		close(file);
+	});
+
+	stub_rtc rtc(fifo);
+	//Thursday 29/02/2024 23:59:58
+	rtc.time.tm_year = 124; rtc.time.tm_mon = 1; rtc.time.tm_mday = 29;
+	rtc.time.tm_hour = 23; rtc.time.tm_min = 59; rtc.time.tm_sec = 58; rtc.time.tm_wday = 4;
+
+	rtc_snapshot snapshot;
+	check(rtc.readSnapshot(snapshot) == 0, "read the time");
+	check(snapshot.hours == 23 && snapshot.minutes == 59 && snapshot.seconds == 58, "decode the time");
+	check(snapshot.date == 29 && snapshot.month == 2 && snapshot.year == 2024, "decode the date");
+	check(snapshot.day == 4 && snapshot.registers[3] == 4, "day of the week (THURSDAY)");
+	check(snapshot.registers[2] == 0x23 && snapshot.registers[6] == 0x24, "raw registers encoded like the DS3231");
+
+	//2100 needs the century bit, the kernel keeps it in tm_year
+	check(rtc.setTime(std::chrono::system_clock::from_time_t(4102444800LL)) == 0, "set the time");
+	check(rtc.sets == 1 && rtc.time.tm_year == 200 && rtc.time.tm_mon == 0 && rtc.time.tm_mday == 1, "RTC_SET_TIME with 01/01/2100");
+	check(rtc.setTime(std::chrono::system_clock::from_time_t(946684799LL)) == 1 && rtc.sets == 1, "reject 1999");
+
+	//the hwmon input is read once per RTC_TEMPERATURE_PERIOD_NS, not on every snapshot
+	writeFile(temperature, "25250\n");
+	rtc.setTemperaturePath(temperature);
+	check(rtc.readSnapshot(snapshot) == 0 && snapshot.temperature == 25.25f && snapshot.temperatureQuarters == 101, "temperature from hwmon");
+	writeFile(temperature, "30000\n");
+	check(rtc.readSnapshot(snapshot) == 0 && snapshot.temperature == 25.25f, "temperature cached between snapshots");
+	float value;
+	check(rtc.readTemperature(value) == 0 && value == 30.0f, "readTemperature() reads the input");
+	check(rtc.readSnapshot(snapshot) == 0 && snapshot.temperature == 30.0f, "readTemperature() refreshes the cache");
+
+	rtc_scheduler scheduler(rtc);
+	int displayed = 0;
+	scheduler.addTask("display", 1, [&](const rtc_snapshot&){ displayed++; });
+	int reads = rtc.reads;
+	check(scheduler.run(3) == 0, "run three ticks");
+	check(scheduler.getTicks() == 3 && displayed == 3 && scheduler.getMissed() == 0, "three ticks from the FIFO");
+	check(rtc.reads - reads == 3, "one RTC_RD_TIME per tick");
+	check(scheduler.alignToEdge() == RTC_SCHEDULER_BACKEND_TICKS, "no edge measurement with backend ticks");
+	check(scheduler.requestResync() == RTC_SCHEDULER_BACKEND_TICKS, "no resync with backend ticks");
+
+	interrupts.join();
+	unlink(fifo);
+	unlink(temperature);
+	*strrchr(fifo, '/') = '\0';
+	*strrchr(temperature, '/') = '\0';
+	rmdir(fifo);
+	rmdir(temperature);
+
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
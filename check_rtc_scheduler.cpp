@@ -0,0 +1,181 @@
+/*
+ * check_rtc_scheduler.cpp
+ *
+ * Exercises the timer driven scheduler without an RTC. A simulated RTC derives its seconds
+ * register from CLOCK_MONOTONIC and a phase that the check can move, and its reads take the
+ * bus time of the DS3231 at 100kHz (about 2ms for a snapshot, 0.4ms for the seconds register
+ * alone). Checks the measured edge, ticks with no gaps, a resync from a job while the ticks
+ * keep running, the realignment after the RTC phase jumps and the counting of missed ticks.
+ * Takes about 15 seconds.
+ *
+ * build: g++ -O2 -std=c++11 check_rtc_scheduler.cpp rtc_scheduler.cpp -o check_rtc_scheduler
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "rtc_scheduler.h"
+
+using namespace i2c;
+
+#define NS_PER_SECOND 1000000000LL
+#define SNAPSHOT_READ_NS 2000000LL
+#define SECONDS_READ_NS   400000LL
+
+static int64_t monotonicNs(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+class simulated_rtc : public rtc_device {
+public:
+	int64_t phaseNs;                //CLOCK_MONOTONIC of a second edge of the RTC
+	unsigned long snapshots, secondsReads;
+
+	simulated_rtc(int64_t phaseNs) {
+		this->phaseNs = phaseNs;
+		snapshots = secondsReads = 0;
+	}
+
+	virtual int readSnapshot(rtc_snapshot &snapshot){
+		memset(&snapshot, 0, sizeof(snapshot));
+		snapshots++;
+		snapshot.monotonicNs = transfer(SNAPSHOT_READ_NS);
+		snapshot.seconds = secondsAt(snapshot.monotonicNs);
+		snapshot.temperature = 25.0f;
+		return 0;
+	}
+
+	virtual int readSeconds(unsigned int &seconds, int64_t &monotonicNs){
+		secondsReads++;
+		monotonicNs = transfer(SECONDS_READ_NS);
+		seconds = secondsAt(monotonicNs);
+		return 0;
+	}
+
+	virtual int readTemperature(float &temperature){ temperature = 25.0f; return 0; }
+	virtual int setTime(std::chrono::system_clock::time_point, bool){ return 0; }
+
+	//distance of a measured edge from the nearest edge of the RTC
+	int64_t edgeError(int64_t edgeNs){
+		int64_t offset = (edgeNs - phaseNs) % NS_PER_SECOND;
+		if(offset < 0) offset += NS_PER_SECOND;
+		return (offset > NS_PER_SECOND / 2) ? NS_PER_SECOND - offset : offset;
+	}
+
+private:
+	unsigned int secondsAt(int64_t ns){
+		return (unsigned int)(((ns - phaseNs) / NS_PER_SECOND) % 60);
+	}
+
+	//busy waits for the length of the transfer, the register is latched in the middle
+	static int64_t transfer(int64_t durationNs){
+		int64_t start = monotonicNs();
+		while(monotonicNs() < start + durationNs);
+		return start + durationNs / 2;
+	}
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what){
+	printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+	if(!condition) failures++;
+}
+
+//true if each displayed second follows the previous one
+static bool consecutive(const std::vector<unsigned int> &seconds, size_t from){
+	for(size_t i=from + 1; i<seconds.size(); i++){
+		if(seconds[i] != (seconds[i - 1] + 1) % 60) return false;
+	}
+	return true;
+}
+
+int main(){
+	//the RTC edges are 300ms into the host seconds, several seconds in the past
+	int64_t now = monotonicNs();
+	simulated_rtc rtc(now - now % NS_PER_SECOND - 5 * NS_PER_SECOND + 300000000LL);
+	rtc_scheduler scheduler(rtc);
+
+	std::vector<unsigned int> displayed;
+	int everyOther = 0, resyncs = 0;
+	bool resync = false, stall = false;
+	int64_t resyncDrift = 0, resyncError = 0;
+	unsigned long resyncReads = 0;
+	scheduler.addTask("display", 1, [&](const rtc_snapshot &snapshot){ displayed.push_back(snapshot.seconds); });
+	scheduler.addTask("every other", 2, [&](const rtc_snapshot&){ everyOther++; });
+	scheduler.addTask("control", 1, [&](const rtc_snapshot&){
+		if(resync){
+			resync = false;
+			resyncReads = rtc.secondsReads;
+			scheduler.requestResync();
+		}
+		if(stall){
+			stall = false;
+			usleep(2500000);
+		}
+	});
+	scheduler.setResyncHandler([&](int64_t driftNs, int64_t errorNs){
+		resyncs++;
+		resyncDrift = driftNs;
+		resyncError = errorNs;
+		resyncReads = rtc.secondsReads - resyncReads;
+	});
+
+	//the edge is found with the short seconds reads, never with a snapshot
+	check(scheduler.requestResync() == 1, "no resync before an edge is known");
+	check(scheduler.alignToEdge() == 0, "measure the edge");
+	printf("edge error %lldus, bracket +/-%lldus\n", (long long)rtc.edgeError(scheduler.getEdgeNs()) / 1000,
+			(long long)scheduler.getEdgeErrorNs() / 1000);
+	check(scheduler.getEdgeErrorNs() < 1000000, "edge bracketed within the polling interval");
+	check(rtc.edgeError(scheduler.getEdgeNs()) <= scheduler.getEdgeErrorNs(), "edge within its bracket");
+	check(rtc.snapshots == 0, "no snapshot read while polling");
+
+	//one snapshot per tick, jobs of the same period share the tick
+	check(scheduler.run(4) == 0, "run four ticks");
+	check(scheduler.getTicks() == 4 && displayed.size() == 4 && everyOther == 2, "jobs run on their periods");
+	check(consecutive(displayed, 0), "one second per tick");
+	check(scheduler.getMissed() == 0 && scheduler.getSlips() == 0, "no missed or slipped ticks");
+	check(rtc.snapshots == 4, "one snapshot per tick");
+	printf("latency: mean %lldus, max %lldus\n", (long long)scheduler.getMeanLatencyNs() / 1000,
+			(long long)scheduler.getMaxLatencyNs() / 1000);
+
+	//a resync from a job polls around the predicted edge while the ticks keep running
+	resync = true;
+	unsigned long snapshots = rtc.snapshots;
+	check(scheduler.run(3) == 0, "run three ticks with a resync");
+	printf("resync: drift %lldus +/-%lldus in %lu reads\n", (long long)resyncDrift / 1000,
+			(long long)resyncError / 1000, resyncReads);
+	check(resyncs == 1, "resync completed");
+	check(llabs(resyncDrift) <= resyncError && resyncError < 2000000, "no drift of an unchanged RTC");
+	check(resyncReads <= 20, "resync polls only the window around the edge");
+	check(rtc.snapshots - snapshots == 3, "no snapshot read by the resync");
+	check(consecutive(displayed, 0) && scheduler.getMissed() == 0, "no tick lost during the resync");
+
+	//the RTC edge moves by 400ms: the next tick reads the same second again, the edge is then
+	//polled for and the ticks follow the new phase
+	rtc.phaseNs += 400000000LL;
+	size_t jump = displayed.size();
+	check(scheduler.run(4) == 0, "run four ticks across a phase jump");
+	check(scheduler.getSlips() == 1, "one slip detected");
+	check(rtc.edgeError(scheduler.getEdgeNs()) <= scheduler.getEdgeErrorNs(), "edge measured again");
+	check(resyncs == 2 && llabs(llabs(resyncDrift) - 400000000LL) <= resyncError, "phase jump reported as drift");
+	check(displayed.size() - jump == 4 && consecutive(displayed, jump + 1), "ticks follow the new phase");
+	check(scheduler.getMissed() == 0, "no tick lost by the realignment");
+
+	//a job that blocks for 2.5s: the timer period in between is counted as missed, not slipped
+	stall = true;
+	size_t stalled = displayed.size();
+	unsigned long slips = scheduler.getSlips();
+	check(scheduler.run(3) == 0, "run three ticks with a stalled job");
+	check(scheduler.getMissed() == 1, "missed tick counted");
+	check(scheduler.getSlips() == slips, "a missed tick is not a slip");
+	check(consecutive(displayed, stalled + 1), "ticks continue after the stall");
+
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
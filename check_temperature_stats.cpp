@@ -0,0 +1,115 @@
+/*
+ * check_temperature_stats.cpp
+ *
+ * Checks the streaming temperature statistics against exact values computed from the stored
+ * samples: Welford mean and variance, the P-square percentiles on 5000 samples quantised to
+ * the 0.25°C resolution of the DS3231, the smoothed rate of change and the alarms with their
+ * hysteresis.
+ *
+ * build: g++ -O2 -std=c++11 check_temperature_stats.cpp temperature_stats.cpp -o check_temperature_stats
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "temperature_stats.h"
+
+using namespace std;
+using namespace i2c;
+
+#define NS_PER_MINUTE 60000000000LL
+
+static int failures = 0;
+
+static void check(bool condition, const char *what){
+	printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+	if(!condition) failures++;
+}
+
+//deterministic pseudo random numbers in [0, 1)
+static double uniform(){
+	static unsigned long long state = 12345;
+	state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//exact percentile of the stored samples (nearest rank)
+static double exact(vector<float> samples, double p){
+	sort(samples.begin(), samples.end());
+	return samples[(size_t)(p * (samples.size() - 1) + 0.5)];
+}
+
+int main(){
+	const int count = 5000;
+	temperature_stats stats(0.1, count);
+	vector<float> samples;
+
+	//about 25°C with a spread of a few degrees, in steps of 0.25°C like the sensor
+	for(int i=0; i<count; i++){
+		double noise = 0;
+		for(int j=0; j<6; j++) noise += uniform() - 0.5;
+		float temperature = floorf((25.0 + 2.0 * noise) * 4 + 0.5f) / 4;
+		samples.push_back(temperature);
+		stats.addSample(temperature, (int64_t)i * 1000000000LL);
+	}
+
+	double sum = 0, squares = 0;
+	for(size_t i=0; i<samples.size(); i++) sum += samples[i];
+	double mean = sum / samples.size();
+	for(size_t i=0; i<samples.size(); i++) squares += (samples[i] - mean) * (samples[i] - mean);
+	double variance = squares / (samples.size() - 1);
+
+	printf("mean %.4f (exact %.4f), variance %.4f (exact %.4f)\n", stats.getMean(), mean, stats.getVariance(), variance);
+	check(stats.samples() == (unsigned long)count, "sample count");
+	check(fabs(stats.getMean() - mean) < 1e-9, "Welford mean");
+	check(fabs(stats.getVariance() - variance) < 1e-9, "Welford variance");
+	check(stats.getMin() == *min_element(samples.begin(), samples.end()), "minimum");
+	check(stats.getMax() == *max_element(samples.begin(), samples.end()), "maximum");
+
+	const temperature_stats::PERCENTILE which[] = {temperature_stats::P50, temperature_stats::P90, temperature_stats::P99};
+	const double p[] = {0.50, 0.90, 0.99};
+	for(int i=0; i<3; i++){
+		double estimate = stats.getPercentile(which[i]), value = exact(samples, p[i]);
+		printf("P%.0f %.3f (exact %.3f)\n", p[i] * 100, estimate, value);
+		check(fabs(estimate - value) <= 0.15, "P-square within 0.15°C of the exact percentile");
+	}
+
+	//fewer than five samples use the nearest rank of the sorted samples
+	p2_quantile median(0.5);
+	median.add(3); median.add(1); median.add(2);
+	check(median.samples() == 3 && median.estimate() == 2, "median of three samples");
+
+	//constant input: the EWMA is the input and the rate is zero
+	temperature_stats constant(0.1, 64);
+	for(int i=0; i<100; i++) constant.addSample(21.5f, (int64_t)i * 1000000000LL);
+	check(constant.getEwma() == 21.5 && constant.getRate() == 0 && constant.getStdDev() == 0, "constant input");
+
+	//a ramp of 1°C per minute sampled every 10 seconds
+	temperature_stats ramp(0.1, 64);
+	for(int i=0; i<100; i++) ramp.addSample(20.0f + i / 6.0f, (int64_t)i * NS_PER_MINUTE / 6);
+	printf("ramp rate %.3f°C/min\n", ramp.getRate());
+	check(fabs(ramp.getRate() - 1.0) < 0.01, "rate of change of a ramp");
+
+	//threshold alarms are raised once and cleared only past the hysteresis
+	temperature_stats alarms(1.0, 64);
+	alarms.setThresholds(10.0f, 30.0f, 0.5f);
+	int64_t now = 0;
+	check(alarms.addSample(25.0f, now += NS_PER_MINUTE) == temperature_stats::ALARM_NONE, "no alarm inside the thresholds");
+	check(alarms.addSample(30.5f, now += NS_PER_MINUTE) == temperature_stats::ALARM_HIGH, "high alarm raised");
+	check(alarms.addSample(31.0f, now += NS_PER_MINUTE) == temperature_stats::ALARM_NONE, "high alarm raised only once");
+	alarms.addSample(29.75f, now += NS_PER_MINUTE);
+	check(alarms.getAlarms() & temperature_stats::ALARM_HIGH, "high alarm held within the hysteresis");
+	alarms.addSample(29.25f, now += NS_PER_MINUTE);
+	check(!(alarms.getAlarms() & temperature_stats::ALARM_HIGH), "high alarm cleared past the hysteresis");
+	check(alarms.addSample(9.5f, now += NS_PER_MINUTE) == temperature_stats::ALARM_LOW, "low alarm raised");
+
+	temperature_stats rate(1.0, 64);
+	rate.setRateLimit(2.0f);
+	check(rate.addSample(20.0f, 0) == temperature_stats::ALARM_NONE, "no rate alarm on the first sample");
+	check(rate.addSample(21.0f, NS_PER_MINUTE) == temperature_stats::ALARM_NONE, "no rate alarm at 1°C/min");
+	check(rate.addSample(24.0f, 2 * NS_PER_MINUTE) == temperature_stats::ALARM_RATE, "rate alarm at 3°C/min");
+
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
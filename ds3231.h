@@ -0,0 +1,105 @@
+/*
+ * ds3231.h
+ *
+ * Header only DS3231 driver built on tmpl::i2c_device. None of the methods are virtual and
+ * the transport is known at compile time, so a call such as getSeconds() inlines down to the
+ * transport read and the BCD conversion.
+ *
+ *    i2c::tmpl::ds3231<i2c::linux_i2c_transport> rtc(1, 0x68);
+ *    i2c::rtc_snapshot snapshot;
+ *    rtc.readSnapshot(snapshot);
+ */
+
+#ifndef DS3231_H_
+#define DS3231_H_
+
+#include <time.h>
+#include "i2c_device_t.h"
+#include "ds3231_registers.h"
+
+namespace i2c {
+namespace tmpl {
+
+/**
+ * @class ds3231
+ * @brief DS3231 real time clock over a compile time transport. Unlike i2c_device_ds3231 the
+ * constructor does not reset the time.
+ */
+template<class Transport>
+class ds3231 : public i2c_device<Transport> {
+public:
+	template<class... Args>
+	explicit ds3231(Args&&... args): i2c_device<Transport>(std::forward<Args>(args)...) {}
+
+	unsigned int getSeconds(){ return ds3231_bcdToDec(this->readRegister(ds3231_map::SECONDS) & 0x7F); }
+	unsigned int getMinutes(){ return ds3231_bcdToDec(this->readRegister(ds3231_map::MINUTES) & 0x7F); }
+	unsigned int getDay()    { return this->readRegister(ds3231_map::DAY) & 0x07; }
+	unsigned int getDate()   { return ds3231_bcdToDec(this->readRegister(ds3231_map::DATE) & 0x3F); }
+	unsigned int getMonth()  { return ds3231_bcdToDec(this->readRegister(ds3231_map::MONTH_CENT) & 0x1F); }
+
+	//hours as shown by the device, 1-12 in 12hr mode
+	unsigned int getHours(){
+		unsigned char value = this->readRegister(ds3231_map::HOURS);
+		return ds3231_bcdToDec(value & ((value & 0x40) ? 0x1F : 0x3F));
+	}
+
+	int getYear(){
+		unsigned char buffer[2];
+		if(this->readRegisters(buffer, 2, ds3231_map::MONTH_CENT)) return 0;
+		return 2000 + ds3231_bcdToDec(buffer[1]) + ((buffer[0] & 0x80) ? 100 : 0);
+	}
+
+	/**
+	 * Read all of the registers in a single burst and decode them, see
+	 * i2c_device_ds3231::readSnapshot()
+	 * @return 1 on failure to read the registers, 0 on success.
+	 */
+	int readSnapshot(rtc_snapshot &snapshot){
+		unsigned char registers[DS3231_REGISTER_COUNT];
+		struct timespec before, after, realtime;
+
+		clock_gettime(CLOCK_MONOTONIC, &before);
+		if(this->readRegisters(registers, DS3231_REGISTER_COUNT, ds3231_map::SECONDS)) return 1;
+		clock_gettime(CLOCK_MONOTONIC, &after);
+		clock_gettime(CLOCK_REALTIME, &realtime);
+
+		ds3231_decode(registers, snapshot);
+		ds3231_stamp(snapshot, before, after, realtime);
+		return 0;
+	}
+
+	/**
+	 * Set the clock from a host time point (UTC) with a single burst write of the seven time
+	 * registers, see i2c_device_ds3231::setTime(). The hours are written in 24hr mode.
+	 * @return 1 if the time is out of range (2000 - 2199) or the write failed, 0 on success.
+	 */
+	int setTime(std::chrono::system_clock::time_point time, bool alignToSecond=false){
+		int64_t anchor = ds3231_monotonicNs();
+		unsigned char registers[7];
+		//encoded before waiting, only the write follows the edge
+		if(ds3231_encode(alignToSecond ? ds3231_nextEdge(time) : time, false, registers)) return 1;
+		if(alignToSecond) ds3231_waitForEdge(time, anchor);
+		return this->writeRegisters(ds3231_map::SECONDS, registers, 7);
+	}
+
+	/**
+	 * Force a temperature conversion and read the result, see ds3231_readTemperature()
+	 * @return 1 on failure to read the device or if the conversion timed out, 0 on success.
+	 */
+	int readTemperature(float &temperature){
+		return ds3231_readTemperature(*this, temperature);
+	}
+
+	/**
+	 * Read only the seconds register, see ds3231_readSeconds()
+	 * @return 1 on failure to read the device, 0 on success.
+	 */
+	int readSeconds(unsigned int &seconds, int64_t &monotonicNs){
+		return ds3231_readSeconds(*this, seconds, monotonicNs);
+	}
+};
+
+} /* namespace tmpl */
+} /* namespace i2c */
+
+#endif /* DS3231_H_ */
@@ -0,0 +1,296 @@
+/*
+ * ds3231_registers.h
+ *
+ * DS3231 register map and the decoding shared by the drivers. Everything here is inline
+ * so that the template driver (ds3231.h) can be fully inlined into its callers.
+ */
+
+#ifndef DS3231_REGISTERS_H_
+#define DS3231_REGISTERS_H_
+
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include "rtc_snapshot.h"
+#include "i2c_diag.h"
+
+//Time between the start of a time write and the moment the seconds register is latched
+//(address, register pointer and seconds byte at 100kHz plus the system call). A write
+//aligned to a second edge is issued this much early.
+#define DS3231_WRITE_LEAD_NS     300000
+
+//A temperature conversion takes up to 200ms (tCONV). While one is running the control and
+//status registers are polled at this interval, and given up on after the timeout.
+#define DS3231_BUSY_POLL_MS      10
+#define DS3231_CONVERSION_TIMEOUT_MS 400
+
+namespace i2c {
+
+//From fig 1. of the DS3231 Data sheet (page 11)
+namespace ds3231_map {
+enum REGISTER {
+	SECONDS         = 0x00,
+	MINUTES         = 0x01,
+	HOURS           = 0x02,
+	DAY             = 0x03,
+	DATE            = 0x04,
+	MONTH_CENT      = 0x05,
+	YEAR            = 0x06,
+	ALARM1_SEC      = 0x07,
+	ALARM1_MIN      = 0x08,
+	ALARM1_HR       = 0x09,
+	ALARM1_DAY_DATE = 0x0A,
+	ALARM2_MIN      = 0x0B,
+	ALARM2_HR       = 0x0C,
+	ALARM2_DAY_DATE = 0x0D,
+	CTRL            = 0x0E,
+	CTRL_STAT       = 0x0F,
+	AGING_OFFSET    = 0x10,
+	TEMP_MSB        = 0x11,
+	TEMP_LSB        = 0x12
+};
+} /* namespace ds3231_map */
+
+inline unsigned int ds3231_bcdToDec(unsigned char bcdValue){
+	return (bcdValue >> 4) * 10 + (bcdValue & 0x0F);
+}
+
+inline unsigned char ds3231_decToBcd(unsigned int decimal){
+	return static_cast<unsigned char>(((decimal / 10) << 4) | (decimal % 10));
+}
+
+inline int64_t ds3231_timespecToNs(const struct timespec &ts){
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline int64_t ds3231_monotonicNs(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ds3231_timespecToNs(now);
+}
+
+//MSB is the signed integer part, the top two bits of the LSB are the fraction
+inline int16_t ds3231_temperatureQuarters(unsigned char msb, unsigned char lsb){
+	return (int16_t)((int8_t)msb * 4 + (lsb >> 6));
+}
+
+/**
+ * Decode a raw register file (registers 0x00 - 0x12) into a snapshot. The host timestamps
+ * of the snapshot are left untouched.
+ * @param registers the DS3231_REGISTER_COUNT raw register values
+ * @param snapshot the snapshot to fill
+ */
+inline void ds3231_decode(const unsigned char *registers, rtc_snapshot &snapshot){
+	using namespace ds3231_map;
+
+	for(int i=0; i<DS3231_REGISTER_COUNT; i++) snapshot.registers[i] = registers[i];
+
+	snapshot.seconds = ds3231_bcdToDec(registers[SECONDS] & 0x7F);
+	snapshot.minutes = ds3231_bcdToDec(registers[MINUTES] & 0x7F);
+	snapshot.hourMode = (registers[HOURS] & 0x40) >> 6;
+	if(snapshot.hourMode){
+		snapshot.pm = (registers[HOURS] & 0x20) >> 5;
+		snapshot.hours = ds3231_bcdToDec(registers[HOURS] & 0x1F);
+	}
+	else{
+		snapshot.pm = 0;
+		snapshot.hours = ds3231_bcdToDec(registers[HOURS] & 0x3F);
+	}
+	snapshot.day = registers[DAY] & 0x07;
+	snapshot.date = ds3231_bcdToDec(registers[DATE] & 0x3F);
+	snapshot.month = ds3231_bcdToDec(registers[MONTH_CENT] & 0x1F);
+	//the century bit is set when the year register wraps from 99 to 00
+	snapshot.year = 2000 + ds3231_bcdToDec(registers[YEAR]) + ((registers[MONTH_CENT] & 0x80) ? 100 : 0);
+
+	snapshot.control = registers[CTRL];
+	snapshot.status = registers[CTRL_STAT];
+	snapshot.agingOffset = (int8_t)registers[AGING_OFFSET];
+	snapshot.reserved = 0;
+
+	snapshot.temperatureQuarters = ds3231_temperatureQuarters(registers[TEMP_MSB], registers[TEMP_LSB]);
+	snapshot.temperature = snapshot.temperatureQuarters * 0.25f;
+}
+
+/**
+ * Validate a calendar time on the host and encode it into the seven time registers
+ * (0x00 - 0x06), including the day of the week and the century bit.
+ * @param year 2000 - 2199
+ * @param month 1 - 12
+ * @param date 1 - days in the month (leap years included)
+ * @param hours 0 - 23, always given in 24hr format
+ * @param minutes 0 - 59
+ * @param seconds 0 - 59
+ * @param twelveHour encode the hours register in 12hr mode
+ * @param registers the seven encoded registers
+ * @return 1 if the time is invalid (nothing is encoded), 0 on success.
+ */
+inline int ds3231_encode(int year, unsigned int month, unsigned int date, unsigned int hours,
+		unsigned int minutes, unsigned int seconds, bool twelveHour, unsigned char *registers){
+	static const unsigned char days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+	if(year < 2000 || year > 2199 || month < 1 || month > 12) return 1;
+	bool isLeapYear = (year % 4 == 0) && (year % 100 != 0 || year % 400 == 0);
+	unsigned int monthDays = days[month - 1] + ((month == 2 && isLeapYear) ? 1 : 0);
+	if(date < 1 || date > monthDays || hours > 23 || minutes > 59 || seconds > 59) return 1;
+
+	//day of the week (Sakamoto), 0 = Sunday, mapped to the MONDAY = 1 ... SUNDAY = 7 sequence
+	static const int offsets[12] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+	int y = (month < 3) ? year - 1 : year;
+	int weekday = (y + y/4 - y/100 + y/400 + offsets[month - 1] + date) % 7;
+
+	using namespace ds3231_map;
+	registers[SECONDS] = ds3231_decToBcd(seconds);
+	registers[MINUTES] = ds3231_decToBcd(minutes);
+	if(twelveHour){
+		unsigned int hour12 = (hours % 12 == 0) ? 12 : hours % 12;
+		registers[HOURS] = 0x40 | ((hours >= 12) ? 0x20 : 0x00) | ds3231_decToBcd(hour12);
+	}
+	else registers[HOURS] = ds3231_decToBcd(hours);
+	registers[DAY] = (weekday == 0) ? 7 : weekday;
+	registers[DATE] = ds3231_decToBcd(date);
+	registers[MONTH_CENT] = ds3231_decToBcd(month) | ((year >= 2100) ? 0x80 : 0x00);
+	registers[YEAR] = ds3231_decToBcd(year % 100);
+	return 0;
+}
+
+/**
+ * Encode a host time point (UTC) into the seven time registers, see ds3231_encode()
+ * @return 1 if the time is outside the range of the RTC, 0 on success.
+ */
+inline int ds3231_encode(std::chrono::system_clock::time_point time, bool twelveHour, unsigned char *registers){
+	time_t seconds = std::chrono::system_clock::to_time_t(time);
+	struct tm utc;
+	if(gmtime_r(&seconds, &utc) == NULL) return 1;
+	return ds3231_encode(utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+			twelveHour, registers);
+}
+
+/**
+ * The whole second a write aligned with ds3231_waitForEdge() sets the clock to
+ * @param time the requested time
+ * @return the next whole second of time, or time itself if it is already whole
+ */
+inline std::chrono::system_clock::time_point ds3231_nextEdge(std::chrono::system_clock::time_point time){
+	using namespace std::chrono;
+	system_clock::time_point whole = time_point_cast<seconds>(time);
+	if(whole > time) whole -= seconds(1);          //time_point_cast rounds towards zero
+	return (whole == time) ? whole : whole + seconds(1);
+}
+
+/**
+ * Wait for the next whole second of a time point. Writing the seconds register restarts the
+ * one second countdown of the DS3231, so a write that lands exactly on the edge sets the clock
+ * with no phase error. The wait follows the host monotonic clock for the fractional part of
+ * the requested time; it sleeps until shortly before the deadline and spins for the rest.
+ * The registers should be encoded from ds3231_nextEdge() before waiting, so that only the
+ * write itself follows the deadline.
+ * @param time the requested time, treated as the time at anchorNs
+ * @param anchorNs CLOCK_MONOTONIC at which time was current, sampled as soon as time is taken
+ * (e.g. on entry to setTime()) so that the bus reads and the encoding done since then do not
+ * delay the write
+ * @return the whole second to write once the function returns, see ds3231_nextEdge()
+ */
+inline std::chrono::system_clock::time_point ds3231_waitForEdge(std::chrono::system_clock::time_point time, int64_t anchorNs){
+	using namespace std::chrono;
+	system_clock::time_point edge = ds3231_nextEdge(time);
+	if(edge == time) return edge;
+
+	struct timespec deadline;
+	int64_t target = anchorNs + duration_cast<nanoseconds>(edge - time).count() - DS3231_WRITE_LEAD_NS;
+	int64_t late = ds3231_monotonicNs() - target;
+	if(late > 0) diag(DIAG_ERROR, "DS3231: aligned write is %lldus late", (long long)(late / 1000));
+
+	//sleep until 200us before the deadline, the timer slack would otherwise add to the error
+	int64_t wake = target - 200000;
+	deadline.tv_sec = wake / 1000000000LL;
+	deadline.tv_nsec = wake % 1000000000LL;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+	do{
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+	} while(ds3231_timespecToNs(deadline) < target);
+	return edge;
+}
+
+/**
+ * Wait until no temperature conversion is running: neither a forced one (CONV) nor the automatic
+ * one (BSY). Both registers are read in one burst every DS3231_BUSY_POLL_MS.
+ * @param device any driver with readRegisters(buffer, number, fromAddress), e.g. i2c_device or
+ * tmpl::i2c_device
+ * @return 1 on failure to read the device or if it is still busy after DS3231_CONVERSION_TIMEOUT_MS,
+ * 0 once it is idle.
+ */
+template<class Device>
+int ds3231_waitForConversion(Device &device){
+	unsigned char state[2];
+	for(int waited=0; ; waited+=DS3231_BUSY_POLL_MS){
+		if(device.readRegisters(state, 2, ds3231_map::CTRL)) return 1;
+		if(!(state[0] & 0x20) && !(state[1] & DS3231_STATUS_BSY)) return 0;
+		if(waited >= DS3231_CONVERSION_TIMEOUT_MS){
+			diag(DIAG_ERROR, "DS3231: temperature conversion timed out");
+			return 1;
+		}
+		usleep(DS3231_BUSY_POLL_MS * 1000);
+	}
+}
+
+/**
+ * Force a temperature conversion and read the result. A conversion requested while the device
+ * is busy would be ignored, so any running conversion is waited for first. The MSB and LSB are
+ * read in a single burst so that they always belong to the same conversion.
+ * @param device any driver with readRegisters() and writeRegister(), see ds3231_waitForConversion()
+ * @param temperature the temperature in °C
+ * @return 1 on failure to read the device or if the conversion timed out, 0 on success.
+ */
+template<class Device>
+int ds3231_readTemperature(Device &device, float &temperature){
+	unsigned char control, buffer[2];
+	if(ds3231_waitForConversion(device)) return 1;
+	if(device.readRegisters(&control, 1, ds3231_map::CTRL)) return 1;
+	//CONV is cleared by the device once the conversion is complete
+	if(device.writeRegister(ds3231_map::CTRL, control | 0x20)) return 1;
+	if(ds3231_waitForConversion(device)) return 1;
+	if(device.readRegisters(buffer, 2, ds3231_map::TEMP_MSB)) return 1;
+	temperature = ds3231_temperatureQuarters(buffer[0], buffer[1]) * 0.25f;
+	return 0;
+}
+
+/**
+ * Read only the seconds register, timestamped like a snapshot. This is the shortest transfer
+ * that shows a second edge (two bytes each way, about 0.4ms at 100kHz against about 2ms for
+ * the whole register file), so an edge polled with it is bracketed to the polling interval.
+ * @param device any driver with readRegisters(buffer, number, fromAddress)
+ * @param seconds the seconds register (0 - 59)
+ * @param monotonicNs CLOCK_MONOTONIC in the middle of the transfer
+ * @return 1 on failure to read the device, 0 on success.
+ */
+template<class Device>
+int ds3231_readSeconds(Device &device, unsigned int &seconds, int64_t &monotonicNs){
+	unsigned char value;
+	int64_t before = ds3231_monotonicNs();
+	if(device.readRegisters(&value, 1, ds3231_map::SECONDS)) return 1;
+	int64_t after = ds3231_monotonicNs();
+	seconds = ds3231_bcdToDec(value & 0x7F);
+	monotonicNs = before + (after - before) / 2;
+	return 0;
+}
+
+/**
+ * Fill in the host timestamps of a snapshot from the clocks sampled around the bus read.
+ * The RTC registers are latched somewhere during the transfer, the middle is the best guess.
+ * @param snapshot the snapshot to stamp
+ * @param before CLOCK_MONOTONIC before the transfer
+ * @param after CLOCK_MONOTONIC after the transfer
+ * @param realtime CLOCK_REALTIME sampled just after the transfer
+ */
+inline void ds3231_stamp(rtc_snapshot &snapshot, const struct timespec &before, const struct timespec &after,
+		const struct timespec &realtime){
+	int64_t start = ds3231_timespecToNs(before), end = ds3231_timespecToNs(after);
+	snapshot.monotonicNs = start + (end - start) / 2;
+	snapshot.realtimeNs = ds3231_timespecToNs(realtime) - (end - start) / 2;
+	snapshot.readLatencyNs = (uint32_t)(end - start);
+	snapshot.reserved2 = 0;
+}
+
+} /* namespace i2c */
+
+#endif /* DS3231_REGISTERS_H_ */
@@ -0,0 +1,144 @@
+#include "eeprom_log.h"
+#include "i2c_diag.h"
+#include <string.h>
+
+namespace i2c {
+
+/**
+ * Constructor for the log. Call mount() before using it.
+ * @param eeprom the EEPROM that holds the log
+ * @param base the first byte of the log area, a multiple of the record size
+ * @param size the size of the log area in bytes, defaults to the whole EEPROM
+ */
+eeprom_log::eeprom_log(i2c_device_at24c32 &eeprom, unsigned int base, unsigned int size): eeprom(eeprom) {
+	this->base = base;
+	this->slots = size / EEPROM_LOG_RECORD_SIZE;
+	this->head = 0;
+	this->sequence = 1;
+	memset(this->latest, 0, sizeof(this->latest));
+}
+
+/**
+ * CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF)
+ */
+uint16_t eeprom_log::crc16(const uint8_t *data, unsigned int length){
+	uint16_t crc = 0xFFFF;
+	for(unsigned int i=0; i<length; i++){
+		crc ^= (uint16_t)data[i] << 8;
+		for(int bit=0; bit<8; bit++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/**
+ * Scan the log area and recover the latest record of each type. The whole area is read with a
+ * single sequential read. Erased (0xFF) and torn records fail the CRC and are ignored; writing
+ * continues after the newest valid record.
+ * @return 1 if the log area is invalid or cannot be read, 0 on success.
+ */
+int eeprom_log::mount(){
+	unsigned char area[AT24C32_SIZE];
+	//each live record may have to be moved ahead of the writer, so there must be spare slots
+	if(this->slots <= EEPROM_LOG_MAX_TYPES || this->base % EEPROM_LOG_RECORD_SIZE != 0 ||
+			this->base + this->slots * EEPROM_LOG_RECORD_SIZE > AT24C32_SIZE){
+		diag(DIAG_ERROR, "EEPROM log: invalid log area");
+		return 1;
+	}
+	if(this->eeprom.readMemory(this->base, area, this->slots * EEPROM_LOG_RECORD_SIZE)) return 1;
+
+	memset(this->latest, 0, sizeof(this->latest));
+	uint32_t newest = 0;
+	this->head = 0;
+	for(unsigned int slot=0; slot<this->slots; slot++){
+		const unsigned char *record = area + slot * EEPROM_LOG_RECORD_SIZE;
+		uint16_t crc = record[14] | (record[15] << 8);
+		uint8_t type = record[4], length = record[5];
+		if(crc != crc16(record, 14) || type == 0 || type >= EEPROM_LOG_MAX_TYPES || length > EEPROM_LOG_PAYLOAD_SIZE) continue;
+
+		uint32_t sequence = record[0] | (record[1] << 8) | (record[2] << 16) | ((uint32_t)record[3] << 24);
+		entry &current = this->latest[type];
+		if(!current.valid || sequence > current.sequence){
+			current.valid = true;
+			current.sequence = sequence;
+			current.slot = slot;
+			current.length = length;
+			memcpy(current.payload, record + 6, EEPROM_LOG_PAYLOAD_SIZE);
+		}
+		if(sequence > newest){
+			newest = sequence;
+			this->head = (slot + 1) % this->slots;
+		}
+	}
+	this->sequence = newest + 1;
+	return 0;
+}
+
+//write a record at the head and make it the latest of its type
+int eeprom_log::writeRecord(uint8_t type, const uint8_t *payload, uint8_t length){
+	unsigned char record[EEPROM_LOG_RECORD_SIZE];
+	record[0] = this->sequence & 0xFF;
+	record[1] = (this->sequence >> 8) & 0xFF;
+	record[2] = (this->sequence >> 16) & 0xFF;
+	record[3] = (this->sequence >> 24) & 0xFF;
+	record[4] = type;
+	record[5] = length;
+	memset(record + 6, 0, EEPROM_LOG_PAYLOAD_SIZE);
+	memcpy(record + 6, payload, length);
+	uint16_t crc = crc16(record, 14);
+	record[14] = crc & 0xFF;
+	record[15] = crc >> 8;
+
+	//a record never crosses a page, so this is a single page write
+	if(this->eeprom.writeMemory(this->base + this->head * EEPROM_LOG_RECORD_SIZE, record, EEPROM_LOG_RECORD_SIZE)) return 1;
+
+	entry &current = this->latest[type];
+	current.valid = true;
+	current.sequence = this->sequence;
+	current.slot = this->head;
+	current.length = length;
+	memcpy(current.payload, record + 6, EEPROM_LOG_PAYLOAD_SIZE);
+
+	this->head = (this->head + 1) % this->slots;
+	this->sequence++;
+	return 0;
+}
+
+/**
+ * Append a record. Slots that hold the latest record of a type are skipped, so a write only
+ * ever replaces a superseded record and nothing is lost if power fails during the write. There
+ * are more slots than types, so a free slot is always found.
+ * @param type the record type (1 - EEPROM_LOG_MAX_TYPES-1), see RECORD
+ * @param payload the data to store
+ * @param length the size of the data, at most EEPROM_LOG_PAYLOAD_SIZE bytes
+ * @return 1 if the record is invalid or the write failed, 0 on success.
+ */
+int eeprom_log::append(uint8_t type, const void *payload, uint8_t length){
+	if(type == 0 || type >= EEPROM_LOG_MAX_TYPES || length > EEPROM_LOG_PAYLOAD_SIZE) return 1;
+
+	for(int skipped=0; skipped<EEPROM_LOG_MAX_TYPES; skipped++){
+		bool live = false;
+		for(int i=1; i<EEPROM_LOG_MAX_TYPES; i++){
+			if(this->latest[i].valid && this->latest[i].slot == this->head) live = true;
+		}
+		if(!live) break;
+		this->head = (this->head + 1) % this->slots;
+	}
+	return this->writeRecord(type, static_cast<const uint8_t*>(payload), length);
+}
+
+/**
+ * Read the latest record of a type
+ * @param type the record type, see RECORD
+ * @param payload the buffer to fill
+ * @param length the expected size of the data
+ * @return 1 if there is no record of this type or its size differs, 0 on success.
+ */
+int eeprom_log::read(uint8_t type, void *payload, uint8_t length) const {
+	if(type == 0 || type >= EEPROM_LOG_MAX_TYPES) return 1;
+	const entry &current = this->latest[type];
+	if(!current.valid || current.length != length) return 1;
+	memcpy(payload, current.payload, length);
+	return 0;
+}
+
+} /* namespace i2c */
@@ -0,0 +1,79 @@
+/*
+ * eeprom_log.h
+ *
+ * Wear levelled record log in the AT24C32 for persistent RTC metadata (calibration, aging
+ * offset, last known good time). Records are appended round robin over the log area, so
+ * writes are spread over all of the cells, and a flush writes one 16 byte record (half a
+ * page) instead of rewriting a page. The slot of the latest record of each type is never
+ * written, so a write torn by a power failure loses at most the record being written.
+ *
+ * Record layout (little endian):
+ *    0-3   sequence number, increases with every record
+ *    4     type (RECORD)
+ *    5     payload length
+ *    6-13  payload
+ *    14-15 CRC-16/CCITT of bytes 0-13
+ */
+
+#ifndef EEPROM_LOG_H_
+#define EEPROM_LOG_H_
+
+#include <stdint.h>
+#include "i2c_device_at24c32.h"
+
+#define EEPROM_LOG_RECORD_SIZE   16
+#define EEPROM_LOG_PAYLOAD_SIZE  8
+#define EEPROM_LOG_MAX_TYPES     8
+
+namespace i2c {
+
+/**
+ * @class eeprom_log
+ * @brief Keeps the latest record of each type in a circular log. Only the latest record of
+ * each type is held in memory.
+ */
+class eeprom_log {
+public:
+	enum RECORD {
+		CALIBRATION = 1,		//float, frequency error in ppm
+		AGING_OFFSET,			//int8_t, DS3231 aging offset register
+		LAST_GOOD_TIME			//int64_t, Unix time (seconds) last known to be good
+	};
+
+private:
+	struct entry {
+		bool valid;
+		uint32_t sequence;
+		unsigned int slot;
+		uint8_t length;
+		uint8_t payload[EEPROM_LOG_PAYLOAD_SIZE];
+	};
+
+	i2c_device_at24c32 &eeprom;
+	unsigned int base, slots;
+	unsigned int head;              //next slot to write
+	uint32_t sequence;              //sequence number of the next record
+	entry latest[EEPROM_LOG_MAX_TYPES];
+
+	int writeRecord(uint8_t type, const uint8_t *payload, uint8_t length);
+
+public:
+	eeprom_log(i2c_device_at24c32 &eeprom, unsigned int base = 0, unsigned int size = AT24C32_SIZE);
+
+	static uint16_t crc16(const uint8_t *data, unsigned int length);
+
+	int mount();
+	int append(uint8_t type, const void *payload, uint8_t length);
+	int read(uint8_t type, void *payload, uint8_t length) const;
+
+	int saveCalibration(float ppm) { return append(CALIBRATION, &ppm, sizeof(ppm)); }
+	int saveAgingOffset(int8_t offset) { return append(AGING_OFFSET, &offset, sizeof(offset)); }
+	int saveLastGoodTime(int64_t seconds) { return append(LAST_GOOD_TIME, &seconds, sizeof(seconds)); }
+	int loadCalibration(float &ppm) const { return read(CALIBRATION, &ppm, sizeof(ppm)); }
+	int loadAgingOffset(int8_t &offset) const { return read(AGING_OFFSET, &offset, sizeof(offset)); }
+	int loadLastGoodTime(int64_t &seconds) const { return read(LAST_GOOD_TIME, &seconds, sizeof(seconds)); }
+};
+
+} /* namespace i2c */
+
+#endif /* EEPROM_LOG_H_ */
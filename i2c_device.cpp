@@ -1,21 +1,11 @@
 #include"i2c_device.h"
-#include<iostream>
-#include<sstream>
+#include"i2c_diag.h"
 #include<fcntl.h>
 #include<stdio.h>
-#include<iomanip>
 #include<unistd.h>
 #include<sys/ioctl.h>
 #include<linux/i2c.h>
 #include<linux/i2c-dev.h>
-using namespace std;
-
-/*formatting output in hexadecimal:
-It sets the width of the output to 2 characters, fills with leading zeros
-if the number is less than two digits, and outputs the number in hexadecimal format.
-The (int)(x) cast ensures that the argument is treated as an integer, 
-*/
-#define HEX(x) setw(2) << setfill('0') << hex << (int)(x) 
 
 namespace i2c {
 
@@ -29,7 +19,7 @@ i2c_device::i2c_device(unsigned int bus, unsigned int device) {
 	this->file=-1;
 	this->bus = bus;
 	this->device = device;
-	if(!this->open()) {perror("I2C bus opened!\n");}
+	this->open();
 }
 
 /**
@@ -37,21 +27,58 @@ i2c_device::i2c_device(unsigned int bus, unsigned int device) {
  * @return 1 on failure to open to the bus or device, 0 on success.
  */
 int i2c_device::open(){
-   string name;
-   if(this->bus==0) name = I2C_0;
-   else name = I2C_1;
+   char name[20];
+   snprintf(name, sizeof(name), "/dev/i2c-%u", this->bus);   //I2C_0, I2C_1, ...
 
-   if((this->file=::open(name.c_str(), O_RDWR)) < 0){  //opening the bus
-      perror("I2C: failed to open the bus\n");
+   if((this->file=::open(name, O_RDWR)) < 0){  //opening the bus
+      diagError("I2C: failed to open the bus");
 	  return 1;
    }
    if(ioctl(this->file, I2C_SLAVE, this->device) < 0){	//setting the address
-      perror("I2C: Failed to connect to the device\n");
+      diagError("I2C: Failed to connect to the device");
 	  return 1;
    }
    return 0;
 }
 
+/**
+ * Check whether the bus is open. The constructor cannot return the result of open(), so a
+ * caller that needs to know whether the bus exists checks this after construction.
+ * @return true if the bus was opened, even if no device acknowledged the address.
+ */
+bool i2c_device::isOpen() const{
+   return this->file != -1;
+}
+
+/**
+ * Change the address of the device on the already open bus. Used to talk to several devices
+ * (e.g. when scanning) without reopening the bus.
+ * @param device The device ID on the bus. (for example: 0x68)
+ * @return 1 if the address is invalid or in use by a kernel driver, 0 on success.
+ */
+int i2c_device::setAddress(unsigned int device){
+   if(ioctl(this->file, I2C_SLAVE, device) < 0) return 1;
+   this->device = device;
+   return 0;
+}
+
+/**
+ * Check whether a device acknowledges its address, without touching any register. An SMBus
+ * quick write is used, except in the ranges where i2cdetect reads a byte instead because a
+ * quick write could corrupt an EEPROM (0x50-0x5F) or confuse some sensors (0x30-0x37).
+ * @return 0 if the device acknowledged, 1 otherwise.
+ */
+int i2c_device::probe(){
+   struct i2c_smbus_ioctl_data args;
+   union i2c_smbus_data data;
+   bool readByte = (this->device >= 0x30 && this->device <= 0x37) || (this->device >= 0x50 && this->device <= 0x5F);
+   args.read_write = readByte ? I2C_SMBUS_READ : I2C_SMBUS_WRITE;
+   args.command = 0;
+   args.size = readByte ? I2C_SMBUS_BYTE : I2C_SMBUS_QUICK;
+   args.data = readByte ? &data : NULL;
+   return (ioctl(this->file, I2C_SMBUS, &args) < 0) ? 1 : 0;
+}
+
 /**
  * Write a single byte value to a single register.
  * @param registerAddress The register address
@@ -64,7 +91,27 @@ int i2c_device::writeRegister(unsigned int registerAddress, unsigned char value)
    buffer[0] = registerAddress;
    buffer[1] = value;
    if(::write(this->file, buffer, 2)!=2){
-      perror("I2C: Failed write to the device\n");
+      diagError("I2C: Failed write to the device");
+      return 1;
+   }
+   return 0;
+}
+
+/**
+ * Write a number of consecutive registers in a single transaction. The device auto increments
+ * its register pointer, so all of the values are written in one burst.
+ * @param fromAddress the first register to write
+ * @param values the values to write
+ * @param number the number of registers to write (at most 255)
+ * @return 1 on failure to write, 0 on success.
+ */
+int i2c_device::writeRegisters(unsigned int fromAddress, const unsigned char *values, unsigned int number){
+   unsigned char buffer[256];
+   if(number > sizeof(buffer) - 1) return 1;
+   buffer[0] = fromAddress;
+   for(unsigned int i=0; i<number; i++) buffer[i+1] = values[i];
+   if(::write(this->file, buffer, number+1)!=(int)(number+1)){
+      diagError("I2C: Failed write to the device");
       return 1;
    }
    return 0;
@@ -80,7 +127,37 @@ int i2c_device::write(unsigned char value){
    unsigned char buffer[1];
    buffer[0]=value;
    if (::write(this->file, buffer, 1)!=1){
-      perror("I2C: Failed to write to the device\n");
+      diagError("I2C: Failed to write to the device");
+      return 1;
+   }
+   return 0;
+}
+
+/**
+ * Write a block of bytes to the device as a single transaction, with no register address
+ * added. Used for devices with wider addresses such as EEPROMs.
+ * @param data the bytes to write
+ * @param number the number of bytes to write
+ * @return 1 on failure to write, 0 on success.
+ */
+int i2c_device::writeBytes(const unsigned char *data, unsigned int number){
+   if(::write(this->file, data, number)!=(int)number){
+      diagError("I2C: Failed write to the device");
+      return 1;
+   }
+   return 0;
+}
+
+/**
+ * Read a block of bytes from the device as a single transaction, starting wherever the
+ * device's address pointer is.
+ * @param data the buffer to fill
+ * @param number the number of bytes to read
+ * @return 1 on failure to read the full block, 0 on success.
+ */
+int i2c_device::readBytes(unsigned char *data, unsigned int number){
+   if(::read(this->file, data, number)!=(int)number){
+      diagError("I2C: Failed to read in the full buffer");
       return 1;
    }
    return 0;
@@ -95,46 +172,75 @@ unsigned char i2c_device::readRegister(unsigned int registerAddress){
    this->write(registerAddress);
    unsigned char buffer[1];
    if(::read(this->file, buffer, 1)!=1){
-      perror("I2C: Failed to read in the value.\n");
+      diagError("I2C: Failed to read in the value");
       return 1;
    }
    return buffer[0];
 }
 
+#ifndef I2C_EMBEDDED
 /**
  * Method to read a number of registers from a single device. This is much more efficient than
  * reading the registers individually. The from address is the starting address to read from, which
- * defaults to 0x00.
+ * defaults to 0x00. Not virtual, so that the class layout is the same in the embedded profile;
+ * the read itself goes through the virtual buffer version below.
  * @param number the number of registers to read from the device
  * @param fromAddress the starting address to read from
- * @return a pointer of type unsigned char* that points to the first element in the block of registers
+ * @return a pointer of type unsigned char* that points to the first element in the block of registers,
+ * to be released with delete[]. NULL on failure.
  */
 unsigned char* i2c_device::readRegisters(unsigned int number, unsigned int fromAddress){
-	this->write(fromAddress);
 	unsigned char* data = new unsigned char[number];
-    if(::read(this->file, data, number)!=(int)number){
-       perror("IC2: Failed to read in the full buffer.\n");
-	   return NULL;
-    }
+	if(this->readRegisters(data, number, fromAddress)){
+		delete[] data;
+		return NULL;
+	}
 	return data;
 }
+#endif
+
+/**
+ * Method to read a number of registers into a buffer supplied by the caller. Unlike the version
+ * above no memory is allocated, so it can be called periodically without leaking.
+ * @param buffer the buffer to fill, must hold at least number bytes
+ * @param number the number of registers to read from the device
+ * @param fromAddress the starting address to read from
+ * @return 1 on failure to read the full block, 0 on success.
+ */
+int i2c_device::readRegisters(unsigned char *buffer, unsigned int number, unsigned int fromAddress){
+	if(this->write(fromAddress)) return 1;
+	if(::read(this->file, buffer, number)!=(int)number){
+		diagError("I2C: Failed to read in the full buffer");
+		return 1;
+	}
+	return 0;
+}
 
 /**
- * Method to dump the registers to the standard output. It inserts a return character after every
- * 16 values and displays the results in hexadecimal to give a standard output using the HEX() macro
- * that is defined at the top of this file. The standard output will stay in hexadecimal format, hence
- * the call on the last like.
- * @param number the total number of registers to dump, defaults to 0xff
+ * Method to dump the registers through the diagnostic sink (DIAG_INFO), one message per 16
+ * values displayed as two digit hexadecimal values. The registers are read in bursts of at most
+ * I2C_MAX_BURST bytes into a local buffer.
+ * @param number the total number of registers to dump
+ * @param fromAddress the first register to dump, defaults to 0x00
  */
 
-void i2c_device::debugDumpRegisters(unsigned int number){
-	cout << "Dumping Registers for Debug Purposes:" << endl;
-	unsigned char *registers = this->readRegisters(number);
-	for(int i=0; i<(int)number; i++){
-		cout << HEX(*(registers+i)) << " ";
-		if (i%16==15) cout << endl;
+void i2c_device::debugDumpRegisters(unsigned int number, unsigned int fromAddress){
+	diag(DIAG_INFO, "Dumping Registers for Debug Purposes:");
+	unsigned char registers[I2C_MAX_BURST];
+	char line[16 * 3 + 1];
+	unsigned int length = 0;
+	for(unsigned int i=0; i<number; i+=I2C_MAX_BURST){
+		unsigned int burst = (number - i < I2C_MAX_BURST) ? number - i : I2C_MAX_BURST;
+		if(this->readRegisters(registers, burst, fromAddress + i)) break;
+		for(unsigned int j=0; j<burst; j++){
+			length += snprintf(line + length, sizeof(line) - length, "%02x ", registers[j]);
+			if ((i+j)%16==15){
+				diag(DIAG_INFO, "%s", line);
+				length = 0;
+			}
+		}
 	}
-	cout << dec;
+	if(length > 0) diag(DIAG_INFO, "%s", line);
 }
 
 /**
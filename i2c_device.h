@@ -35,6 +35,9 @@
 #define I2C_0 "/dev/i2c-0"
 #define I2C_1 "/dev/i2c-1"
 
+//largest burst used when reading a block of registers
+#define I2C_MAX_BURST 32
+
 namespace i2c {
 
 /**
@@ -49,11 +52,23 @@ private:
 public:
 	i2c_device(unsigned int bus, unsigned int device);
 	virtual int open();
+	bool isOpen() const;
+	virtual int setAddress(unsigned int device);
+	virtual int probe();
 	virtual int write(unsigned char value);
+	virtual int writeBytes(const unsigned char *data, unsigned int number);
+	virtual int readBytes(unsigned char *data, unsigned int number);
 	virtual unsigned char readRegister(unsigned int registerAddress);
-	virtual unsigned char* readRegisters(unsigned int number, unsigned int fromAddress=0);
+#ifndef I2C_EMBEDDED
+	//allocates the returned buffer (delete[] it), not available in the embedded profile. Not
+	//virtual, so the vtable is the same with and without I2C_EMBEDDED
+	unsigned char* readRegisters(unsigned int number, unsigned int fromAddress=0);
+#endif
+	virtual int readRegisters(unsigned char *buffer, unsigned int number, unsigned int fromAddress=0);
 	virtual int writeRegister(unsigned int registerAddress, unsigned char value);
-	virtual void debugDumpRegisters(unsigned int number = 0xff);
+	virtual int writeRegisters(unsigned int fromAddress, const unsigned char *values, unsigned int number);
+	//the register count differs per device, so it has no default here
+	virtual void debugDumpRegisters(unsigned int number, unsigned int fromAddress = 0);
 	virtual void close();
 	virtual ~i2c_device();
 };
@@ -0,0 +1,97 @@
+#include "i2c_device_at24c32.h"
+#include "i2c_diag.h"
+#include <time.h>
+
+namespace i2c {
+
+/**
+ * Constructor for the EEPROM. It passes the bus number and the device address (0x57 by default
+ * on the DS3231 modules) to the constructor of i2c_device. The memory is not touched.
+ * @param I2CBus The bus number that the EEPROM is on - typically 1
+ * @param I2CAddress The address of the EEPROM
+ */
+i2c_device_at24c32::i2c_device_at24c32(unsigned int I2CBus, unsigned int I2CAddress):
+	i2c_device(I2CBus, I2CAddress){
+	this->I2CBus = I2CBus;
+	this->I2CAddress = I2CAddress;
+	this->writeCycles = 0;
+	this->pollCount = 0;
+}
+
+//dummy write of the two address bytes, sets the address pointer of the device
+int i2c_device_at24c32::setPointer(unsigned int address){
+	unsigned char buffer[2] = {(unsigned char)((address >> 8) & 0x0F), (unsigned char)(address & 0xFF)};
+	return this->writeBytes(buffer, 2);
+}
+
+/**
+ * Sequential read. The device increments its address pointer itself, so any length is read with
+ * one address write followed by reads of up to AT24C32_READ_CHUNK bytes.
+ * @param address the first byte to read (0 - 4095)
+ * @param data the buffer to fill
+ * @param number the number of bytes to read
+ * @return 1 if the range is out of the memory or the read failed, 0 on success.
+ */
+int i2c_device_at24c32::readMemory(unsigned int address, unsigned char *data, unsigned int number){
+	if(address + number > AT24C32_SIZE) return 1;
+	if(number == 0) return 0;
+	if(this->setPointer(address)) return 1;
+	for(unsigned int i=0; i<number; i+=AT24C32_READ_CHUNK){
+		unsigned int chunk = (number - i < AT24C32_READ_CHUNK) ? number - i : AT24C32_READ_CHUNK;
+		if(this->readBytes(data + i, chunk)) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Page write. The data is split at the 32 byte page boundaries (a write that crosses a page
+ * would wrap around inside the page) and each page is written as a single burst. After each
+ * page the device is polled until its write cycle completes, instead of waiting a fixed time.
+ * @param address the first byte to write (0 - 4095)
+ * @param data the bytes to write
+ * @param number the number of bytes to write
+ * @return 1 if the range is out of the memory or a write failed, 0 on success.
+ */
+int i2c_device_at24c32::writeMemory(unsigned int address, const unsigned char *data, unsigned int number){
+	if(address + number > AT24C32_SIZE) return 1;
+	unsigned char buffer[2 + AT24C32_PAGE_SIZE];
+	unsigned int written = 0;
+	while(written < number){
+		unsigned int current = address + written;
+		unsigned int room = AT24C32_PAGE_SIZE - (current % AT24C32_PAGE_SIZE);
+		unsigned int chunk = (number - written < room) ? number - written : room;
+
+		buffer[0] = (current >> 8) & 0x0F;
+		buffer[1] = current & 0xFF;
+		for(unsigned int i=0; i<chunk; i++) buffer[2 + i] = data[written + i];
+		if(this->writeBytes(buffer, 2 + chunk)) return 1;
+		this->writeCycles++;
+		if(this->waitForWriteCycle()) return 1;
+		written += chunk;
+	}
+	return 0;
+}
+
+/**
+ * Acknowledge polling: the device does not acknowledge its address while the internal write
+ * cycle is running, so it is probed until it answers.
+ * @return 1 if the device did not answer within AT24C32_WRITE_TIMEOUT_NS, 0 on success.
+ */
+int i2c_device_at24c32::waitForWriteCycle(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long deadline = now.tv_sec * 1000000000LL + now.tv_nsec + AT24C32_WRITE_TIMEOUT_NS;
+	while(true){
+		this->pollCount++;
+		if(this->probe() == 0) return 0;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if(now.tv_sec * 1000000000LL + now.tv_nsec > deadline){
+			diag(DIAG_ERROR, "EEPROM: write cycle did not complete");
+			return 1;
+		}
+	}
+}
+
+i2c_device_at24c32::~i2c_device_at24c32() {}
+
+} /* namespace i2c */
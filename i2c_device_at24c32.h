@@ -0,0 +1,42 @@
+#ifndef I2C_DEVICE_AT24C32_H_
+#define I2C_DEVICE_AT24C32_H_
+#include"i2c_device.h"
+
+//AT24C32 on the common DS3231 modules (A0-A2 pulled up)
+#define AT24C32_DEFAULT_ADDRESS     0x57
+#define AT24C32_SIZE                4096
+#define AT24C32_PAGE_SIZE           32
+//largest sequential read issued in one transaction (i2c-dev limit is 8192)
+#define AT24C32_READ_CHUNK          4096
+//write cycle time is 10ms at 5V and 20ms at 2.7V
+#define AT24C32_WRITE_TIMEOUT_NS    25000000LL
+
+namespace i2c {
+
+/**
+ * @class i2c_device_at24c32
+ * @brief Driver for the AT24C32 32Kbit EEPROM. Addresses are 12 bits, sent as two bytes.
+ */
+class i2c_device_at24c32:protected i2c_device{
+private:
+	unsigned int I2CBus, I2CAddress;
+	unsigned long writeCycles, pollCount;
+
+	int setPointer(unsigned int address);
+
+public:
+	i2c_device_at24c32(unsigned int I2CBus, unsigned int I2CAddress=AT24C32_DEFAULT_ADDRESS);
+
+	virtual int readMemory(unsigned int address, unsigned char *data, unsigned int number);
+	virtual int writeMemory(unsigned int address, const unsigned char *data, unsigned int number);
+	virtual int waitForWriteCycle();
+
+	unsigned long getWriteCycles() const { return writeCycles; }
+	unsigned long getPollCount() const { return pollCount; }
+
+	virtual ~i2c_device_at24c32();
+};
+
+} /* namespace i2c */
+
+#endif /* I2C_DEVICE_AT24C32_H_ */
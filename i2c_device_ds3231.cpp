@@ -1,38 +1,15 @@
 
 
 #include "i2c_device_ds3231.h"
-#include <iostream>
+#include "i2c_diag.h"
 #include <unistd.h>
 #include <math.h>
 #include <stdio.h>
 
 
-using namespace std;
-
 namespace i2c {
 
-//From fig 1. of the DS3231 Data sheet (page 11)
-//Register address mapping
-//Since the addresses are sequential, an enum can also be used.
-#define SECONDS_REG        		0x00  
-#define MINUTES_REG    	   		0x01  
-#define HOURS_REG          		0x02  
-#define DAY_REG            		0x03  
-#define DATE_REG           		0x04  
-#define MONTH_CENT_REG     		0x05  
-#define YEAR_REG           		0x06  
-#define ALARM1_SEC_REG     		0x07  
-#define ALARM1_MIN_REG     		0x08  
-#define ALARM1_HR_REG           0x09  
-#define ALARM1_DAY_DATE_REG     0x0A  
-#define ALARM2_MIN_REG     		0x0B  
-#define ALARM2_HR_REG      		0x0C  
-#define ALARM2_DAY_DATE_REG    	0x0D  
-#define CTRL_REG           		0x0E  
-#define CTRL_STAT_REG      		0x0F  
-#define AGING_OFFSET_REG   		0x10  
-#define TEMP_MSB_REG       		0x11  
-#define TEMP_LSB_REG       		0x12  
+//The register map (ds3231_map) is in ds3231_registers.h, shared with the template driver
 
 /**
  * The constructor for the ADXL345 accelerometer object. It passes the bus number and the
@@ -53,9 +30,11 @@ namespace i2c {
 	1		0		0		0		1		0		1		0
 	
 	All other registers default to 0x00
- 
+
+	resetRegisters can be set to false to attach to a running clock without
+	touching the time (e.g. for the shared memory time service)
 */
-i2c_device_ds3231::i2c_device_ds3231(unsigned int I2CBus, unsigned int I2CAddress):
+i2c_device_ds3231::i2c_device_ds3231(unsigned int I2CBus, unsigned int I2CAddress, bool resetRegisters):
 	i2c_device(I2CBus, I2CAddress){   // this member initialisation list calls the parent constructor
 	
 	this->I2CAddress = I2CAddress;
@@ -73,7 +52,7 @@ i2c_device_ds3231::i2c_device_ds3231(unsigned int I2CBus, unsigned int I2CAddres
 	this->wave = i2c_device_ds3231::WAVE_2;
 	this->clk = i2c_device_ds3231::CLOCK_RUN;
 		
-	this->initUpdateAllRegisters();
+	if(resetRegisters) this->initUpdateAllRegisters();
 }
 
 //Update all registers (time and date)
@@ -81,13 +60,13 @@ int i2c_device_ds3231::initUpdateAllRegisters(){
 
    int check = 0;
    
-   check += (this->writeRegister(SECONDS_REG, DS3231_REGISTER_SECONDS_DEFAULT)); //Seconds: 00
-   check += (this->writeRegister(MINUTES_REG, DS3231_REGISTER_MINUTES_DEFAULT)); //Minutes: 00
-   check += (this->writeRegister(HOURS_REG, DS3231_REGISTER_HOURS_DEFAULT)); //Hours: 00 | 24hr format
-   check += (this->writeRegister(DAY_REG, DS3231_REGISTER_DAY_OF_WEEK_DEFAULT)); //User defined 01 Monday
-   check += (this->writeRegister(MONTH_CENT_REG, DS3231_REGISTER_MONTH_DEFAULT)); //01
-   check += (this->writeRegister(DATE_REG, DS3231_REGISTER_DATE_DEFAULT)); //01
-   check += (this->writeRegister(YEAR_REG, DS3231_REGISTER_YEAR_DEFAULT)); //2000
+   check += (this->writeRegister(ds3231_map::SECONDS, DS3231_REGISTER_SECONDS_DEFAULT)); //Seconds: 00
+   check += (this->writeRegister(ds3231_map::MINUTES, DS3231_REGISTER_MINUTES_DEFAULT)); //Minutes: 00
+   check += (this->writeRegister(ds3231_map::HOURS, DS3231_REGISTER_HOURS_DEFAULT)); //Hours: 00 | 24hr format
+   check += (this->writeRegister(ds3231_map::DAY, DS3231_REGISTER_DAY_OF_WEEK_DEFAULT)); //User defined 01 Monday
+   check += (this->writeRegister(ds3231_map::MONTH_CENT, DS3231_REGISTER_MONTH_DEFAULT)); //01
+   check += (this->writeRegister(ds3231_map::DATE, DS3231_REGISTER_DATE_DEFAULT)); //01
+   check += (this->writeRegister(ds3231_map::YEAR, DS3231_REGISTER_YEAR_DEFAULT)); //2000
    
    return check;
 }
@@ -96,6 +75,63 @@ int i2c_device_ds3231::initUpdateAllRegisters(){
 
 /*********************************************************************************************/
 
+/**
+ * Decode a raw register file (registers 0x00 - 0x12) into a snapshot, see ds3231_decode()
+ * @param registers the DS3231_REGISTER_COUNT raw register values
+ * @param snapshot the snapshot to fill
+ */
+void i2c_device_ds3231::decodeSnapshot(const unsigned char *registers, rtc_snapshot &snapshot){
+	ds3231_decode(registers, snapshot);
+}
+
+/**
+ * Read all of the registers in a single burst and decode them. The temperature registers are
+ * refreshed by the device every 64 seconds, so no conversion is forced here. The host clocks are
+ * sampled around the transfer to anchor the RTC time to the host time.
+ * @param snapshot the snapshot to fill
+ * @return 1 on failure to read the registers, 0 on success.
+ */
+int i2c_device_ds3231::readSnapshot(rtc_snapshot &snapshot){
+
+	unsigned char registers[DS3231_REGISTER_COUNT];
+	struct timespec before, after, realtime;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	if(this->readRegisters(registers, DS3231_REGISTER_COUNT, ds3231_map::SECONDS)) return 1;
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	clock_gettime(CLOCK_REALTIME, &realtime);
+
+	ds3231_decode(registers, snapshot);
+	ds3231_stamp(snapshot, before, after, realtime);
+	this->updateFromSnapshot(snapshot);
+	this->temperature = snapshot.temperature;
+	return 0;
+}
+
+/**
+ * Read only the seconds register, for polling the second edge, see ds3231_readSeconds().
+ * The object is not updated.
+ * @param seconds the seconds register (0 - 59)
+ * @param monotonicNs CLOCK_MONOTONIC in the middle of the transfer
+ * @return 1 on failure to read the device, 0 on success.
+ */
+int i2c_device_ds3231::readSeconds(unsigned int &seconds, int64_t &monotonicNs){
+	return ds3231_readSeconds(static_cast<i2c_device&>(*this), seconds, monotonicNs);
+}
+
+//update the object (time and date only)
+void i2c_device_ds3231::updateFromSnapshot(const rtc_snapshot &snapshot){
+	this->seconds = snapshot.seconds;
+	this->minutes = snapshot.minutes;
+	this->hours = snapshot.hours;
+	this->day = snapshot.day;
+	this->date = snapshot.date;
+	this->month = snapshot.month;
+	this->year = snapshot.year;
+	this->hr_mode = static_cast<HOUR_MODE>(snapshot.hourMode);
+	this->am_pm = static_cast<AFTER_BEFORE_NOON>(snapshot.pm);
+}
+
 
  
 void i2c_device_ds3231::displayTimeAndDate(){
@@ -122,44 +158,37 @@ void i2c_device_ds3231::displayTimeAndDate(){
 			sprintf(dateTimeStr, "%02d:%02d:%02d   %02d/%02d/%d", hours, minutes, seconds, date, month, year);
 	}
 	
-	cout << dateTimeStr << "\n" <<endl;
+	diag(DIAG_INFO, "%s", dateTimeStr);
 	
 }
 
 int i2c_device_ds3231::displayTemperature(){
 	
-	//Convert temperature
-	unsigned int oldRegisterVal = this->readRegister(CTRL_REG);
-	this->writeRegister(CTRL_REG, (oldRegisterVal | (0x20)));
-
-	//check for BSY status, if cleared then read then display
-	while((this->readRegister(CTRL_STAT_REG) & 0x04) >> 2){
-		//wait untill the BSY bit is cleared
-		//this means conversion is complete and device no longer busy
-	}
-		
-		// Read the temperature registers
-		unsigned char temp_msb = this->readRegister(TEMP_MSB_REG); // Register 11h
-		unsigned char temp_lsb = this->readRegister(TEMP_LSB_REG); // Register 12h
-
-		// Combine the MSB and the top two bits of the LSB to get the 10-bit raw temperature value
-		int raw_temperature = ((temp_msb << 2) | (temp_lsb >> 6));
-
-		// Check if the temperature is negative
-		bool negative = temp_msb & 0x80; // Check sign bit
+	if(this->readTemperature(this->temperature)) return 1;
+	diag(DIAG_INFO, "The temperature is %g°C", this->temperature);
+	return 0;
+}
 
-		// If negative, we must convert the 10-bit value from 2's complement to a negative decimal
-		if (negative) {
-			// Invert and add 1 to get the two's complement
-			raw_temperature = ~raw_temperature & 0x3FF; // Mask to 10 bits
-			raw_temperature = (raw_temperature + 1) * -1;
-		}
+/**
+ * Dump the registers, see i2c_device::debugDumpRegisters()
+ * @param number the number of registers to dump, defaults to the DS3231_REGISTER_COUNT
+ * registers of the device (the address pointer wraps after the last one)
+ * @param fromAddress the first register to dump, defaults to 0x00
+ */
+void i2c_device_ds3231::debugDumpRegisters(unsigned int number, unsigned int fromAddress){
+	i2c_device::debugDumpRegisters(number, fromAddress);
+}
 
-		// Convert the raw temperature to Celsius
-		this->temperature = raw_temperature * 0.25;
-		
-		cout << "The temperature is " << this->temperature << "°C" << "\n" << endl;
-		return 0;
+/**
+ * Force a temperature conversion and read the result, see ds3231_readTemperature()
+ * @param temperature the temperature in °C
+ * @return 1 on failure to read the device or if the conversion timed out, 0 on success.
+ */
+int i2c_device_ds3231::readTemperature(float &temperature){
+	
+	if(ds3231_readTemperature(static_cast<i2c_device&>(*this), temperature)) return 1;
+	this->temperature = temperature;
+	return 0;
 }
 
 void i2c_device_ds3231::setDate(unsigned int date, unsigned int month, int year){
@@ -171,7 +200,7 @@ void i2c_device_ds3231::setDate(unsigned int date, unsigned int month, int year)
 	
 	if(invalidData){
 		//set date to default
-		cerr << "Setting date back to 01/01/2000" << endl;
+		diag(DIAG_ERROR, "Setting date back to 01/01/2000");
 		setYear(2000);
 		setMonth(1);
 		setDate(1);;
@@ -187,7 +216,7 @@ void i2c_device_ds3231::setTime(unsigned int hours, unsigned int minutes, unsign
 	
 	if(invalidData){
 		//set date to default
-		cerr << "Setting time back to 00:00:00" << endl;
+		diag(DIAG_ERROR, "Setting time back to 00:00:00");
 		setYear(0);
 		setMonth(0);
 		setDate(0);;
@@ -197,41 +226,99 @@ void i2c_device_ds3231::setTime(unsigned int hours, unsigned int minutes, unsign
 	
 }
 
+/**
+ * Refresh the 12/24hr mode from bit 6 of the hours register. The mode set by the constructor is
+ * only a default, the clock may be running in 12hr mode when attached to without a reset.
+ * @return 1 on failure to read the register, 0 on success.
+ */
+int i2c_device_ds3231::readHourMode(){
+	unsigned char value;
+	if(this->readRegisters(&value, 1, ds3231_map::HOURS)) return 1;
+	this->hr_mode = (value & 0x40) ? TWELVE : TWENTYFOUR;
+	return 0;
+}
+
+/**
+ * Set the time and date. The values are validated on the host and all seven time registers are
+ * written in a single burst, so the clock cannot tick between the fields. The hours register keeps
+ * the current 12/24hr mode.
+ */
 void i2c_device_ds3231::setTimeAndDate(unsigned int hours, unsigned int minutes, unsigned int seconds, unsigned int date, unsigned int month, int year){
-	setDate(date, month, year);
-	setTime(hours, minutes, seconds);
 	
+	if(this->readHourMode()) return;
+	//only the time registers are used, the rest are zero so the buffer can be decoded
+	unsigned char registers[DS3231_REGISTER_COUNT] = {0};
+	if(ds3231_encode(year, month, date, hours, minutes, seconds, hr_mode == TWELVE, registers)){
+		//set time and date to default
+		diag(DIAG_ERROR, "Time or date out of range or invalid");
+		diag(DIAG_ERROR, "Setting time and date back to 00:00:00 01/01/2000");
+		ds3231_encode(2000, 1, 1, 0, 0, 0, hr_mode == TWELVE, registers);
+	}
+	if(this->writeRegisters(ds3231_map::SECONDS, registers, 7) == 0){
+		rtc_snapshot snapshot;
+		ds3231_decode(registers, snapshot);
+		this->updateFromSnapshot(snapshot);
+	}
+}
+
+/**
+ * Set the clock from a host time point (UTC) with a single burst write of the seven time
+ * registers, including the day of the week and the century bit.
+ * @param time the time to set, e.g. std::chrono::system_clock::now(); it is taken as the time on
+ * entry, so it should be sampled just before the call
+ * @param alignToSecond delay the write to the next whole second of time so that the seconds
+ * register is written on the second edge (sub-millisecond phase error)
+ * @return 1 if the time is out of range (2000 - 2199) or the device cannot be accessed, 0 on success.
+ */
+int i2c_device_ds3231::setTime(std::chrono::system_clock::time_point time, bool alignToSecond){
+	//the edge wait is measured from here, not from after the hour mode read and the encoding
+	int64_t anchor = ds3231_monotonicNs();
+	//only the time registers are used, the rest are zero so the buffer can be decoded
+	unsigned char registers[DS3231_REGISTER_COUNT] = {0};
+	if(this->readHourMode()) return 1;
+	//encoded before waiting, so that only the write follows the edge
+	if(ds3231_encode(alignToSecond ? ds3231_nextEdge(time) : time, hr_mode == TWELVE, registers)){
+		diag(DIAG_ERROR, "Time out of range (2000 - 2199)");
+		return 1;
+	}
+	if(alignToSecond) ds3231_waitForEdge(time, anchor);
+	if(this->writeRegisters(ds3231_map::SECONDS, registers, 7)) return 1;
+	
+	rtc_snapshot snapshot;
+	ds3231_decode(registers, snapshot);
+	this->updateFromSnapshot(snapshot);
+	return 0;
 }
 
 
 
 
  
-unsigned int i2c_device_ds3231::getSeconds(){return bcdToDec(this->readRegister(SECONDS_REG));}
+unsigned int i2c_device_ds3231::getSeconds(){return bcdToDec(this->readRegister(ds3231_map::SECONDS));}
 
 unsigned int i2c_device_ds3231::setSeconds(unsigned int seconds){
 	if(seconds < 60){
-		this->writeRegister(SECONDS_REG, decimalToBCD(seconds));
+		this->writeRegister(ds3231_map::SECONDS, decimalToBCD(seconds));
 		//update the object 
 		this->seconds = getSeconds();
 		return 0;
 	}
 	else{
-		cerr << "Seconds out of range (00-59)" << endl;
+		diag(DIAG_ERROR, "Seconds out of range (00-59)");
 		return 1;
 	}
 }
 
-unsigned int i2c_device_ds3231::getMinutes(){return bcdToDec(this->readRegister(MINUTES_REG));}
+unsigned int i2c_device_ds3231::getMinutes(){return bcdToDec(this->readRegister(ds3231_map::MINUTES));}
 
 unsigned int i2c_device_ds3231::setMinutes(unsigned int minutes){
 	if(minutes < 60){
-		this->writeRegister(MINUTES_REG, decimalToBCD(minutes));
+		this->writeRegister(ds3231_map::MINUTES, decimalToBCD(minutes));
 		this->minutes = getMinutes();
 		return 0;
 	}
 	else{
-		cerr << "Minutes out of range (00-59)" << endl;
+		diag(DIAG_ERROR, "Minutes out of range (00-59)");
 		return 1;
 	}
 }
@@ -241,17 +328,17 @@ unsigned int i2c_device_ds3231::getHours(){
 	unsigned int hourTens;
 	unsigned int hourOnes;
 	
-	switch((this->readRegister(HOURS_REG) & 0x40) >> 6){
+	switch((this->readRegister(ds3231_map::HOURS) & 0x40) >> 6){
 		case 0:
 			this->hr_mode = i2c_device_ds3231::TWENTYFOUR;
-			hourOnes = this->readRegister(HOURS_REG) & 0x0F;
-			hourTens = ((this->readRegister(HOURS_REG) & 0x30) >> 4) * 10;
+			hourOnes = this->readRegister(ds3231_map::HOURS) & 0x0F;
+			hourTens = ((this->readRegister(ds3231_map::HOURS) & 0x30) >> 4) * 10;
 			break;
 		case 1:
 			this->hr_mode = i2c_device_ds3231::TWELVE;
-			am_pm = static_cast<AFTER_BEFORE_NOON>((this->readRegister(HOURS_REG) & 0x20) >> 5);
-			hourOnes = this->readRegister(HOURS_REG) & 0x0F;
-			hourTens = ((this->readRegister(HOURS_REG) & 0x10) >> 4) * 10;
+			am_pm = static_cast<AFTER_BEFORE_NOON>((this->readRegister(ds3231_map::HOURS) & 0x20) >> 5);
+			hourOnes = this->readRegister(ds3231_map::HOURS) & 0x0F;
+			hourTens = ((this->readRegister(ds3231_map::HOURS) & 0x10) >> 4) * 10;
 			break;
 	}
 
@@ -264,13 +351,13 @@ unsigned int i2c_device_ds3231::setHours(unsigned int hours){
 	
 	unsigned int hourTens;
 	unsigned int hourOnes;
-	unsigned int oldRegisterVal = this->readRegister(HOURS_REG);
+	unsigned int oldRegisterVal = this->readRegister(ds3231_map::HOURS);
 	
 	if(hours > -1 && hours < 13){
 		//will write to the register and leave everything else unchanged
 		hourTens = hours / 10;
 		hourOnes = hours % 10;
-		this->writeRegister(HOURS_REG, ((oldRegisterVal & 0xE0) | (((hourTens << 4) | hourOnes) & 0x1F)));
+		this->writeRegister(ds3231_map::HOURS, ((oldRegisterVal & 0xE0) | (((hourTens << 4) | hourOnes) & 0x1F)));
 		this->hours   = getHours();
 		return 0;
 	} 
@@ -279,12 +366,12 @@ unsigned int i2c_device_ds3231::setHours(unsigned int hours){
 		hourTens = hours / 10;
 		hourOnes = hours % 10;
 		this->changeHrMode(TWENTYFOUR);
-		this->writeRegister(HOURS_REG, ((oldRegisterVal & 0xC0) | (((hourTens << 4) | hourOnes) & 0x3F)));
+		this->writeRegister(ds3231_map::HOURS, ((oldRegisterVal & 0xC0) | (((hourTens << 4) | hourOnes) & 0x3F)));
 		this->hours   = getHours();
 		return 0;
 	}
 	else{
-		cerr << "Hours out of range (00-23) (1-12)" << endl;
+		diag(DIAG_ERROR, "Hours out of range (00-23) (1-12)");
 		return 1;
 	}
 }
@@ -292,16 +379,16 @@ unsigned int i2c_device_ds3231::setHours(unsigned int hours){
 
 
 
-unsigned int i2c_device_ds3231::getDay(){return bcdToDec(this->readRegister(DAY_REG));}
+unsigned int i2c_device_ds3231::getDay(){return bcdToDec(this->readRegister(ds3231_map::DAY));}
 
 unsigned int i2c_device_ds3231::setDay(unsigned int day){
 	if(day > 0 && minutes < 8){
-		this->writeRegister(DAY_REG, (decimalToBCD(day) & 0x07));
+		this->writeRegister(ds3231_map::DAY, (decimalToBCD(day) & 0x07));
 		this->day = 	getDay();
 		return 0;
 	}
 	else{
-		cerr << "Days out of range (1-7)" << endl;
+		diag(DIAG_ERROR, "Days out of range (1-7)");
 		return 1;
 	}
 }
@@ -311,8 +398,8 @@ unsigned int i2c_device_ds3231::getDate(){
 	unsigned int dateOnes;
 	unsigned int dateTens;
 	
-	dateOnes = (this->readRegister(DATE_REG) & 0x0F);
-	dateTens = ((this->readRegister(DATE_REG) & 0x30) >> 4) * 10;
+	dateOnes = (this->readRegister(ds3231_map::DATE) & 0x0F);
+	dateTens = ((this->readRegister(ds3231_map::DATE) & 0x30) >> 4) * 10;
 			
 	return dateOnes + dateTens;
 }
@@ -344,13 +431,13 @@ unsigned int i2c_device_ds3231::setDate(unsigned int date){
 	
 	if(isValidDate){
 	
-		this->writeRegister(DATE_REG, (decimalToBCD(date)));
+		this->writeRegister(ds3231_map::DATE, (decimalToBCD(date)));
 		this->date = 	getDate();
 		return 0;
 	}
 	
 	else{
-		cerr << "Date out of range or invalid" << endl;
+		diag(DIAG_ERROR, "Date out of range or invalid");
 		return 1;
 		
 	}
@@ -363,22 +450,22 @@ unsigned int i2c_device_ds3231::getMonth(){
 	unsigned int monthOnes;
 	unsigned int monthTens;
 	
-	monthOnes = (this->readRegister(MONTH_CENT_REG) & 0x0F);
-	monthTens = ((this->readRegister(MONTH_CENT_REG) & 0x10) >> 4) * 10;
+	monthOnes = (this->readRegister(ds3231_map::MONTH_CENT) & 0x0F);
+	monthTens = ((this->readRegister(ds3231_map::MONTH_CENT) & 0x10) >> 4) * 10;
 			
 	return monthOnes + monthTens;
 }
 
 unsigned int i2c_device_ds3231::setMonth(unsigned int month){
 	
-	unsigned int oldRegisterVal = this->readRegister(MONTH_CENT_REG);
+	unsigned int oldRegisterVal = this->readRegister(ds3231_map::MONTH_CENT);
 	if(month > 0 && month < 13){
-		this->writeRegister(MONTH_CENT_REG, ((oldRegisterVal & 0xE0) | (decimalToBCD(month) & 0x1F)));
+		this->writeRegister(ds3231_map::MONTH_CENT, ((oldRegisterVal & 0xE0) | (decimalToBCD(month) & 0x1F)));
 		this->month = getMonth();
 		return 0;
 	}
 	else{
-		cerr << "Month out of range (1-12)" << endl;
+		diag(DIAG_ERROR, "Month out of range (1-12)");
 		return 1;
 	}
 }
@@ -388,10 +475,10 @@ int i2c_device_ds3231::getYear(){
 	unsigned int yearOnes;
 	unsigned int yearTens;
 	
-	yearOnes = (this->readRegister(YEAR_REG) & 0x0F);
-	yearTens = ((this->readRegister(YEAR_REG) & 0xF0) >> 4) * 10;
+	yearOnes = (this->readRegister(ds3231_map::YEAR) & 0x0F);
+	yearTens = ((this->readRegister(ds3231_map::YEAR) & 0xF0) >> 4) * 10;
 	
-	if ((this->readRegister(MONTH_CENT_REG) & 0x80) >> 7){
+	if ((this->readRegister(ds3231_map::MONTH_CENT) & 0x80) >> 7){
 		return (2100 + yearOnes + yearTens);
 	}
 	else {
@@ -413,34 +500,36 @@ int i2c_device_ds3231::setYear(int year){
 		int yearTensAndOnes = year % 100;
 		
 		
-		this->writeRegister(YEAR_REG, (decimalToBCD(yearTensAndOnes)));
+		this->writeRegister(ds3231_map::YEAR, (decimalToBCD(yearTensAndOnes)));
 		this->year = 	getYear();
 		return 0;
 	}
 	
 	else{
-		cerr << "Year out of range (2000 - 2099)" << endl;
+		diag(DIAG_ERROR, "Year out of range (2000 - 2099)");
 		return 1;
 		
 	}
 }
 
 void i2c_device_ds3231::changeHrMode(unsigned int mode){
-	unsigned int oldRegisterVal = this->readRegister(HOURS_REG);
+	unsigned int oldRegisterVal = this->readRegister(ds3231_map::HOURS);
 	
 	switch(mode){
 		case i2c_device_ds3231::TWENTYFOUR:
-		this->writeRegister(HOURS_REG, (oldRegisterVal & !(0x40)));
+		this->writeRegister(ds3231_map::HOURS, (oldRegisterVal & !(0x40)));
+		this->hr_mode = i2c_device_ds3231::TWENTYFOUR;
 		break;
 		case i2c_device_ds3231::TWELVE:
-		this->writeRegister(HOURS_REG, (oldRegisterVal | (0x40)));
+		this->writeRegister(ds3231_map::HOURS, (oldRegisterVal | (0x40)));
+		this->hr_mode = i2c_device_ds3231::TWELVE;
 		break;
 	}
 }
  unsigned char i2c_device_ds3231::decimalToBCD(int decimal){
 	 
     if (decimal < 0 || decimal > 99) {
-        cerr << "Decimal number out of range for a single BCD byte (0-99)" << std::endl;
+        diag(DIAG_ERROR, "Decimal number out of range for a single BCD byte (0-99)");
         return 0;
     }
 	
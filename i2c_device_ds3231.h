@@ -3,6 +3,8 @@
 #ifndef I2C_DEVICE_DS3231_H_
 #define I2C_DEVICE_DS3231_H_
 #include"i2c_device.h"
+#include"ds3231_registers.h"
+#include<chrono>
 
 
 
@@ -82,26 +84,29 @@ private:
 /* 	virtual int updateAllRegisters();
 	virtual int resetAllRegisters(); */
 
-	virtual unsigned int getSeconds();
-	virtual unsigned int getMinutes();
-	virtual unsigned int getHours();
-	virtual unsigned int getDay();
-	virtual unsigned int getDate();
-	virtual unsigned int getMonth();
-	virtual int			 getYear();
+	//not virtual: these are only used internally and can be inlined
+	unsigned int getSeconds();
+	unsigned int getMinutes();
+	unsigned int getHours();
+	unsigned int getDay();
+	unsigned int getDate();
+	unsigned int getMonth();
+	int			 getYear();
 	
-	virtual unsigned int setSeconds	(unsigned int seconds);
-	virtual unsigned int setMinutes	(unsigned int minutes);
-	virtual unsigned int setHours	(unsigned int hours);
-	virtual unsigned int setDay		(unsigned int day);
-	virtual unsigned int setDate	(unsigned int date);
-	virtual unsigned int setMonth	(unsigned int month);
-	virtual int			 setYear	(int year);
+	unsigned int setSeconds	(unsigned int seconds);
+	unsigned int setMinutes	(unsigned int minutes);
+	unsigned int setHours	(unsigned int hours);
+	unsigned int setDay		(unsigned int day);
+	unsigned int setDate	(unsigned int date);
+	unsigned int setMonth	(unsigned int month);
+	int			 setYear	(int year);
+	void		 updateFromSnapshot(const rtc_snapshot &snapshot);
+	int			 readHourMode();
 	
 	
 public:
 	/*public functions APIs*/
-	i2c_device_ds3231(unsigned int I2CBus, unsigned int I2CAddress=0x68);
+	i2c_device_ds3231(unsigned int I2CBus, unsigned int I2CAddress=0x68, bool resetRegisters=true);
 	virtual int initUpdateAllRegisters();
 	//those might be moved to private
 
@@ -112,17 +117,27 @@ public:
 	}
 	
 	static unsigned char decimalToBCD(int decimal);
+	static void decodeSnapshot(const unsigned char *registers, rtc_snapshot &snapshot);
 
+	//reads the whole register file in one burst (time, status and temperature)
+	virtual int readSnapshot(rtc_snapshot &snapshot);
+	//reads the seconds register alone, to find the second edge with short transfers
+	virtual int readSeconds(unsigned int &seconds, int64_t &monotonicNs);
+	//dumps the register file by default, not the 256 bytes of the generic dump
+	virtual void debugDumpRegisters(unsigned int number = DS3231_REGISTER_COUNT, unsigned int fromAddress = 0);
 
 
 	virtual void displayTimeAndDate();
 	virtual int displayTemperature();
+	virtual int readTemperature(float &temperature);
 	
 	virtual void changeHrMode(unsigned int mode);
 	virtual void setTimeAndDate(unsigned int hours, unsigned int minutes, unsigned int seconds, unsigned int date, unsigned int month, int year);
 	//time is only set by user in 24 format but it will retain the current format for time
 	virtual void setTime(unsigned int hours, unsigned int minutes, unsigned int seconds);
 	virtual void setDate(unsigned int date, unsigned int month, int year);
+	//sets all time registers in one burst, optionally on the next whole second of time
+	virtual int setTime(std::chrono::system_clock::time_point time, bool alignToSecond=false);
 	
 	virtual ~i2c_device_ds3231();
 };
@@ -0,0 +1,79 @@
+/*
+ * i2c_device_t.h
+ *
+ * Template version of i2c_device. The transport is a template parameter instead of a file
+ * handle behind virtual methods, so register access is resolved at compile time and can be
+ * inlined into the driver. Use rtc_device.h when runtime polymorphism is needed.
+ */
+
+#ifndef I2C_DEVICE_T_H_
+#define I2C_DEVICE_T_H_
+
+#include <utility>
+#include "i2c_transport.h"
+
+namespace i2c {
+namespace tmpl {
+
+/**
+ * @class i2c_device
+ * @brief Generic I2C device over a compile time transport (see i2c_transport.h)
+ */
+template<class Transport>
+class i2c_device {
+protected:
+	Transport bus;
+public:
+	//the arguments are passed on to the transport, e.g. (bus, device) for linux_i2c_transport
+	template<class... Args>
+	explicit i2c_device(Args&&... args): bus(std::forward<Args>(args)...) {}
+
+	Transport& transport() { return bus; }
+
+	/**
+	 * Read a single register value from the address on the device.
+	 * @param registerAddress the address to read from
+	 * @return the byte value at the register address.
+	 */
+	unsigned char readRegister(unsigned int registerAddress){
+		unsigned char buffer[1] = {(unsigned char)registerAddress};
+		if(bus.write(buffer, 1) || bus.read(buffer, 1)) return 1;
+		return buffer[0];
+	}
+
+	/**
+	 * Read a number of registers into the caller's buffer in one burst.
+	 * @return 1 on failure to read the full block, 0 on success.
+	 */
+	int readRegisters(unsigned char *buffer, unsigned int number, unsigned int fromAddress=0){
+		unsigned char address = (unsigned char)fromAddress;
+		if(bus.write(&address, 1)) return 1;
+		return bus.read(buffer, number);
+	}
+
+	/**
+	 * Write a single byte value to a single register.
+	 * @return 1 on failure to write, 0 on success.
+	 */
+	int writeRegister(unsigned int registerAddress, unsigned char value){
+		unsigned char buffer[2] = {(unsigned char)registerAddress, value};
+		return bus.write(buffer, 2);
+	}
+
+	/**
+	 * Write a number of consecutive registers in a single transaction (at most 255).
+	 * @return 1 on failure to write, 0 on success.
+	 */
+	int writeRegisters(unsigned int fromAddress, const unsigned char *values, unsigned int number){
+		unsigned char buffer[256];
+		if(number > sizeof(buffer) - 1) return 1;
+		buffer[0] = (unsigned char)fromAddress;
+		for(unsigned int i=0; i<number; i++) buffer[i+1] = values[i];
+		return bus.write(buffer, number + 1);
+	}
+};
+
+} /* namespace tmpl */
+} /* namespace i2c */
+
+#endif /* I2C_DEVICE_T_H_ */
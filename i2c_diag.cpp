@@ -0,0 +1,48 @@
+#include "i2c_diag.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+namespace i2c {
+
+#ifdef I2C_EMBEDDED
+static diag_sink sink = NULL;
+#else
+static diag_sink sink = stdioDiagnosticSink;
+#endif
+
+/**
+ * Install the function that receives the diagnostic messages
+ * @param newSink the sink, NULL to drop all messages
+ */
+void setDiagnosticSink(diag_sink newSink){
+	sink = newSink;
+}
+
+/**
+ * Sink that writes information to the standard output and errors to the standard error
+ */
+void stdioDiagnosticSink(DIAG_LEVEL level, const char *message){
+	FILE *stream = (level == DIAG_ERROR) ? stderr : stdout;
+	fputs(message, stream);
+	fputc('\n', stream);
+}
+
+void diag(DIAG_LEVEL level, const char *format, ...){
+	if(sink == NULL) return;
+	char message[I2C_DIAG_MESSAGE_SIZE];
+	va_list arguments;
+	va_start(arguments, format);
+	vsnprintf(message, sizeof(message), format, arguments);
+	va_end(arguments);
+	sink(level, message);
+}
+
+void diagError(const char *message){
+	if(sink == NULL) return;
+	int error = errno;
+	diag(DIAG_ERROR, "%s: %s", message, strerror(error));
+}
+
+} /* namespace i2c */
@@ -0,0 +1,39 @@
+/*
+ * i2c_diag.h
+ *
+ * Lightweight diagnostics for the drivers. Messages are formatted into a small stack buffer
+ * and handed to a sink function, so the drivers need neither iostreams nor the heap. The
+ * output of the display and dump methods (displayTimeAndDate(), debugDumpRegisters(), ...)
+ * goes to the same sink as DIAG_INFO messages, one line per message.
+ *
+ * The default sink writes to stdout/stderr. In the embedded profile (I2C_EMBEDDED) there is
+ * no default sink and messages are dropped without being formatted until the application
+ * installs one, e.g. setDiagnosticSink(stdioDiagnosticSink) or a sink writing to a UART.
+ */
+
+#ifndef I2C_DIAG_H_
+#define I2C_DIAG_H_
+
+//longest message passed to the sink, longer messages are truncated
+#define I2C_DIAG_MESSAGE_SIZE 128
+
+namespace i2c {
+
+enum DIAG_LEVEL {
+	DIAG_INFO,
+	DIAG_ERROR
+};
+
+typedef void (*diag_sink)(DIAG_LEVEL level, const char *message);
+
+void setDiagnosticSink(diag_sink sink);
+void stdioDiagnosticSink(DIAG_LEVEL level, const char *message);
+
+//printf style message, without the trailing new line
+void diag(DIAG_LEVEL level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+//error message followed by the description of errno, replaces perror()
+void diagError(const char *message);
+
+} /* namespace i2c */
+
+#endif /* I2C_DIAG_H_ */
@@ -0,0 +1,157 @@
+/*
+ * i2c_tool.cpp
+ *
+ * Bus scan and register dump tool built on i2c_device, for diagnosing live systems.
+ *
+ * usage:
+ *    i2c_tool scan [bus ...]                                   probe every address, one thread per bus
+ *    i2c_tool dump <bus> <address> <from> <count>              dump a register range
+ *    i2c_tool watch <bus> <address> <from> <count> [ms]        print only the registers that change
+ *
+ * Scanning uses SMBus quick probes, so no register is read or written. The dump and watch modes
+ * read the range in bursts of at most I2C_MAX_BURST bytes; watch re-reads it at the given period
+ * (1000ms by default), which bounds the bus load to one burst per period. The count has no
+ * default: most devices have far fewer than 256 registers and wrap their address pointer, so
+ * a full page would read the same registers several times (the DS3231 has 0x13).
+ *
+ * build: g++ -O2 -std=c++11 -pthread i2c_tool.cpp i2c_device.cpp i2c_diag.cpp -o i2c_tool
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <time.h>
+#include "i2c_device.h"
+
+using namespace std;
+using namespace i2c;
+
+#define HEX(x) setw(2) << setfill('0') << hex << (int)(x)
+
+//valid 7-bit addresses, the others are reserved
+#define FIRST_ADDRESS 0x03
+#define LAST_ADDRESS  0x77
+
+static void usage(){
+   cerr << "usage: i2c_tool scan [bus ...]" << endl;
+   cerr << "       i2c_tool dump <bus> <address> <from> <count>" << endl;
+   cerr << "       i2c_tool watch <bus> <address> <from> <count> [period ms]" << endl;
+}
+
+/**
+ * Probe every address on a bus and format the result like i2cdetect: the address of each
+ * device that acknowledges, UU for addresses held by a kernel driver and -- otherwise.
+ */
+static void scanBus(unsigned int bus, string *result){
+   ostringstream out;
+   i2c_device device(bus, FIRST_ADDRESS);
+   if(!device.isOpen()){
+      out << "bus " << bus << ": not available" << endl;
+      *result = out.str();
+      return;
+   }
+   out << "bus " << bus << ":" << endl << "     0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f" << endl;
+   for(unsigned int row=0; row<0x80; row+=16){
+      out << HEX(row) << ":";
+      for(unsigned int address=row; address<row+16; address++){
+         if(address < FIRST_ADDRESS || address > LAST_ADDRESS) out << "   ";
+         else if(device.setAddress(address)) out << " UU";
+         else if(device.probe() == 0) out << " " << HEX(address);
+         else out << " --";
+      }
+      out << endl;
+   }
+   *result = out.str();
+}
+
+static int readRange(i2c_device &device, unsigned char *buffer, unsigned int from, unsigned int count){
+   for(unsigned int i=0; i<count; i+=I2C_MAX_BURST){
+      unsigned int burst = (count - i < I2C_MAX_BURST) ? count - i : I2C_MAX_BURST;
+      if(device.readRegisters(buffer + i, burst, from + i)) return 1;
+   }
+   return 0;
+}
+
+static void printRange(const unsigned char *buffer, unsigned int from, unsigned int count){
+   for(unsigned int i=0; i<count; i++){
+      if(i == 0 || (from + i) % 16 == 0){
+         if(i != 0) cout << endl;
+         cout << HEX(from + i) << ":";
+         for(unsigned int pad=(from + i) % 16; pad>0; pad--) cout << "   ";
+      }
+      cout << " " << HEX(buffer[i]);
+   }
+   cout << dec << endl;
+}
+
+int main(int argc, char *argv[]) {
+   if(argc < 2){
+      usage();
+      return 1;
+   }
+   string mode = argv[1];
+
+   if(mode == "scan"){
+      vector<unsigned int> buses;
+      for(int i=2; i<argc; i++) buses.push_back(strtoul(argv[i], NULL, 0));
+      if(buses.empty()) buses.push_back(1);
+
+      //each bus is scanned by its own thread, the output is printed once all are done
+      vector<string> results(buses.size());
+      vector<thread> threads;
+      for(size_t i=0; i<buses.size(); i++) threads.push_back(thread(scanBus, buses[i], &results[i]));
+      for(size_t i=0; i<threads.size(); i++) threads[i].join();
+      for(size_t i=0; i<results.size(); i++) cout << results[i];
+      return 0;
+   }
+
+   if((mode != "dump" && mode != "watch") || argc < 6){
+      usage();
+      return 1;
+   }
+   unsigned int bus = strtoul(argv[2], NULL, 0);
+   unsigned int address = strtoul(argv[3], NULL, 0);
+   unsigned int from = strtoul(argv[4], NULL, 0);
+   unsigned int count = strtoul(argv[5], NULL, 0);
+   long period = (argc > 6) ? strtol(argv[6], NULL, 0) : 1000;
+   if(from > 0xff || count == 0 || from + count > 0x100 || period <= 0){
+      cerr << "Register range or period out of range" << endl;
+      return 1;
+   }
+
+   i2c_device device(bus, address);
+   if(!device.isOpen() || device.setAddress(address)){
+      cerr << "Cannot access device 0x" << HEX(address) << dec << " on bus " << bus << endl;
+      return 1;
+   }
+   unsigned char current[0x100], latest[0x100];
+   if(readRange(device, current, from, count)) return 1;
+   printRange(current, from, count);
+   if(mode == "dump") return 0;
+
+   struct timespec next, start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   next = start;
+   while(true){
+      next.tv_nsec += (period % 1000) * 1000000L;
+      next.tv_sec += period / 1000 + next.tv_nsec / 1000000000L;
+      next.tv_nsec %= 1000000000L;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+      if(readRange(device, latest, from, count)) continue;
+
+      double elapsed = (next.tv_sec - start.tv_sec) + (next.tv_nsec - start.tv_nsec) / 1e9;
+      for(unsigned int i=0; i<count; i++){
+         if(latest[i] != current[i]){
+            cout << "[" << fixed << setprecision(3) << elapsed << "] 0x" << HEX(from + i) << ": 0x"
+                 << HEX(current[i]) << " -> 0x" << HEX(latest[i]) << dec << endl;
+            current[i] = latest[i];
+         }
+      }
+   }
+   return 0;
+}
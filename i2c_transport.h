@@ -0,0 +1,115 @@
+/*
+ * i2c_transport.h
+ *
+ * Transports for the template drivers (see i2c_device_t.h). A transport only has to provide
+ *    int write(const unsigned char *data, unsigned int number);
+ *    int read(unsigned char *data, unsigned int number);
+ * returning 0 on success and 1 on failure, like the methods of i2c_device. The transport is a
+ * template parameter of the driver, so these calls are resolved at compile time and inlined.
+ */
+
+#ifndef I2C_TRANSPORT_H_
+#define I2C_TRANSPORT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include "i2c_diag.h"
+
+namespace i2c {
+
+/**
+ * @class linux_i2c_transport
+ * @brief Transport over the Linux i2c-dev interface (/dev/i2c-N)
+ */
+class linux_i2c_transport {
+private:
+	int file;
+public:
+	linux_i2c_transport(): file(-1) {}
+
+	/**
+	 * Opens the bus and sets the device address, as i2c_device does
+	 * @param bus The bus number. (for example: 1)
+	 * @param device The device ID on the bus. (for example: 0x68)
+	 */
+	linux_i2c_transport(unsigned int bus, unsigned int device): file(-1) {
+		this->open(bus, device);
+	}
+
+	linux_i2c_transport(const linux_i2c_transport&) = delete;
+	linux_i2c_transport& operator=(const linux_i2c_transport&) = delete;
+
+	/**
+	 * @return 1 on failure to open to the bus or device, 0 on success.
+	 */
+	int open(unsigned int bus, unsigned int device){
+		char name[20];
+		snprintf(name, sizeof(name), "/dev/i2c-%u", bus);
+		if((this->file=::open(name, O_RDWR)) < 0){
+			diagError("I2C: failed to open the bus");
+			return 1;
+		}
+		if(ioctl(this->file, I2C_SLAVE, device) < 0){
+			diagError("I2C: Failed to connect to the device");
+			return 1;
+		}
+		return 0;
+	}
+
+	int write(const unsigned char *data, unsigned int number){
+		if(::write(this->file, data, number)!=(int)number){
+			diagError("I2C: Failed write to the device");
+			return 1;
+		}
+		return 0;
+	}
+
+	int read(unsigned char *data, unsigned int number){
+		if(::read(this->file, data, number)!=(int)number){
+			diagError("I2C: Failed to read in the full buffer");
+			return 1;
+		}
+		return 0;
+	}
+
+	void close(){
+		if(this->file != -1) ::close(this->file);
+		this->file = -1;
+	}
+
+	~linux_i2c_transport(){ this->close(); }
+};
+
+/**
+ * @class memory_transport
+ * @brief A 256 byte register file in memory that behaves like an I2C device with an auto
+ * incrementing register pointer. Used for benchmarks and for testing without hardware.
+ */
+class memory_transport {
+public:
+	unsigned char registers[256];
+	unsigned char pointer;
+
+	memory_transport(): pointer(0) { memset(registers, 0, sizeof(registers)); }
+
+	//the first byte written sets the register pointer, the rest are stored from there
+	int write(const unsigned char *data, unsigned int number){
+		if(number == 0) return 0;
+		this->pointer = data[0];
+		for(unsigned int i=1; i<number; i++) this->registers[this->pointer++] = data[i];
+		return 0;
+	}
+
+	int read(unsigned char *data, unsigned int number){
+		for(unsigned int i=0; i<number; i++) data[i] = this->registers[this->pointer++];
+		return 0;
+	}
+};
+
+} /* namespace i2c */
+
+#endif /* I2C_TRANSPORT_H_ */
@@ -22,49 +22,116 @@
  * For more details, see http://www.derekmolloy.ie/
  */
 
+/*
+ * build: g++ -O2 -std=c++11 rtc_app.cpp i2c_device.cpp i2c_device_ds3231.cpp i2c_diag.cpp rtc_scheduler.cpp
+ *        rtc_backend.cpp rtc_kernel_device.cpp temperature_stats.cpp -o rtc_app
+ */
+
 #include <iostream>
-#include <unistd.h>
-#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
 #include "i2c_device_ds3231.h"
+#include "rtc_device.h"
+#include "rtc_backend.h"
+#include "rtc_scheduler.h"
+#include "temperature_stats.h"
 
 using namespace std;
 using namespace i2c;
 
-int main() {
-   i2c_device_ds3231 rtc(1,0x68);
-   
-   rtc.displayTimeAndDate();
-   sleep(1);
+static void displaySnapshot(const rtc_snapshot &snapshot){
+   if(snapshot.hourMode == i2c_device_ds3231::TWELVE)
+      printf("%02d:%02d:%02d %s   %02d/%02d/%d\n", snapshot.hours, snapshot.minutes, snapshot.seconds,
+             snapshot.pm ? "PM" : "AM", snapshot.date, snapshot.month, snapshot.year);
+   else
+      printf("%02d:%02d:%02d   %02d/%02d/%d\n", snapshot.hours, snapshot.minutes, snapshot.seconds,
+             snapshot.date, snapshot.month, snapshot.year);
+}
+
+/**
+ * Run the periodic jobs on the RTC second ticks, all of the jobs due on a tick share one burst
+ * read of the RTC.
+ */
+static int runJobs(rtc_device &device, unsigned long ticks){
+   rtc_scheduler scheduler(device);
+   temperature_stats stats(0.1, 60);
+   //same limits as the rtc_tempmon defaults
+   stats.setThresholds(0.0f, 50.0f, 0.5f);
+   stats.setRateLimit(2.0f);
+
+   scheduler.addTask("display", 1, displaySnapshot);
+   //the DS3231 refreshes the temperature registers every 64 seconds
+   scheduler.addTask("temperature", 64, [&](const rtc_snapshot &snapshot){
+      unsigned int raised = stats.addSample(snapshot.temperature, snapshot.monotonicNs);
+      if(raised & temperature_stats::ALARM_HIGH) cerr << "ALARM: temperature above 50°C" << endl;
+      if(raised & temperature_stats::ALARM_LOW) cerr << "ALARM: temperature below 0°C" << endl;
+      if(raised & temperature_stats::ALARM_RATE) cerr << "ALARM: temperature changing faster than 2°C/min" << endl;
+   });
+   scheduler.addTask("log", 60, [&](const rtc_snapshot &snapshot){
+      printf("T=%.2f°C mean=%.2f min=%.2f max=%.2f | ticks=%lu missed=%lu slips=%lu latency mean=%lldus max=%lldus edge=±%lldus\n",
+             snapshot.temperature, stats.getMean(), stats.getMin(), stats.getMax(),
+             scheduler.getTicks(), scheduler.getMissed(), scheduler.getSlips(),
+             (long long)scheduler.getMeanLatencyNs() / 1000, (long long)scheduler.getMaxLatencyNs() / 1000,
+             (long long)scheduler.getEdgeErrorNs() / 1000);
+   });
+   //the edge is measured in the background, changes within the measurement error are not reported.
+   //With backend ticks there is no edge to measure and requestResync() returns RTC_SCHEDULER_BACKEND_TICKS.
+   scheduler.addTask("resync", 600, [&](const rtc_snapshot&){ scheduler.requestResync(); });
+   scheduler.setResyncHandler([](int64_t driftNs, int64_t errorNs){
+      if(llabs(driftNs) > errorNs)
+         printf("Resync: RTC edge moved %+lldus (±%lldus) against the host\n", (long long)driftNs / 1000, (long long)errorNs / 1000);
+   });
+
+   return scheduler.run(ticks);
+}
+
+/*
+ * usage: rtc_app [ticks] [backend]
+ * Runs the set/display checks, sets the RTC from the host clock and then runs the periodic
+ * jobs on the RTC second ticks (forever when ticks is 0 or not given).
+ * When a backend is given (see rtc_backend.h, e.g. /dev/rtc0) the checks are skipped and the
+ * jobs run on that backend without changing the time.
+ */
+int main(int argc, char *argv[]) {
+   unsigned long ticks = (argc > 1) ? strtoul(argv[1], NULL, 0) : 0;
+
+   if(argc > 2){
+      rtc_device *backend = rtc_backend_open(argv[2]);
+      if(backend == NULL) return 1;
+      int result = runJobs(*backend, ticks);
+      delete backend;
+      return result;
+   }
+
+   rtc_device_model<i2c_device_ds3231> device(1, 0x68);
+   i2c_device_ds3231 &rtc = device.get();
+
+   //each set is a single burst write, so it can be checked straight away
    rtc.displayTimeAndDate();
-   sleep(3);
    rtc.changeHrMode(i2c_device_ds3231::TWELVE);
    rtc.displayTimeAndDate();
    rtc.displayTemperature();
 
-   sleep(1);
-
    rtc.setTimeAndDate(14,30,55,26,10,2024);
-   sleep(1);
    rtc.displayTimeAndDate();
-   
+
    //leap year test
    rtc.setTimeAndDate(14,30,55,29,2,2024);
-   sleep(1);
    rtc.displayTimeAndDate();
-   
+
    rtc.setTimeAndDate(14,30,55,29,2,2025);
-   sleep(1);
    rtc.displayTimeAndDate();
-   
+
    //31/30 test
    rtc.setTimeAndDate(14,30,55,30,4,2025);
-   sleep(1);
    rtc.displayTimeAndDate();
-   
+
    rtc.setTimeAndDate(14,30,55,31,4,2025);
-   sleep(1);
    rtc.displayTimeAndDate();
-   
-   
-   return 0;
-}
\ No newline at end of file
+
+   //follow the host clock, written on the second edge
+   device.setTime(chrono::system_clock::now(), true);
+
+   return runJobs(device, ticks);
+}
@@ -0,0 +1,67 @@
+#include "rtc_backend.h"
+#include "rtc_kernel_device.h"
+#include "ds3231.h"
+#include "i2c_diag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+
+namespace i2c {
+
+#define RTC_0_NAME    "/sys/class/rtc/rtc0/name"
+#define RTC_0_HWMON   "/sys/class/rtc/rtc0/device/hwmon/hwmon*/temp1_input"
+
+typedef rtc_device_model<tmpl::ds3231<linux_i2c_transport> > i2c_backend;
+
+/**
+ * Check whether rtc0 is provided by the kernel driver for the DS1307 family (rtc-ds1307, which
+ * handles the DS3231 as well). In that case raw i2c-dev access would compete with the kernel.
+ */
+static bool kernelOwnsRtc(){
+	FILE *input = fopen(RTC_0_NAME, "r");
+	if(input == NULL) return false;
+	char name[64] = "";
+	if(fgets(name, sizeof(name), input) == NULL) name[0] = '\0';
+	fclose(input);
+	return strstr(name, "ds1307") != NULL || strstr(name, "ds3231") != NULL;
+}
+
+static rtc_device* openKernel(const char *path){
+	rtc_kernel_device *rtc = new rtc_kernel_device(path);
+	//the driver registers a hwmon device for the DS3231 temperature sensor
+	if(strcmp(path, RTC_0) == 0){
+		glob_t found;
+		if(glob(RTC_0_HWMON, 0, NULL, &found) == 0 && found.gl_pathc > 0) rtc->setTemperaturePath(found.gl_pathv[0]);
+		globfree(&found);
+	}
+	return rtc;
+}
+
+/**
+ * Open an RTC backend from a specification string, see rtc_backend.h
+ * @param spec the backend specification
+ * @return the backend (to be deleted by the caller), NULL if the specification is invalid.
+ */
+rtc_device* rtc_backend_open(const char *spec){
+	if(spec == NULL || strcmp(spec, "auto") == 0){
+		if(kernelOwnsRtc()) return openKernel(RTC_0);
+		return new i2c_backend(1, 0x68);
+	}
+	if(strncmp(spec, "rtc:", 4) == 0) return openKernel(spec + 4);
+	if(spec[0] == '/') return openKernel(spec);
+	if(strncmp(spec, "i2c", 3) == 0){
+		unsigned int bus = 1, address = 0x68;
+		const char *field = strchr(spec, ':');
+		if(field != NULL){
+			char *end;
+			bus = strtoul(field + 1, &end, 0);
+			if(*end == ':') address = strtoul(end + 1, NULL, 0);
+		}
+		return new i2c_backend(bus, address);
+	}
+	diag(DIAG_ERROR, "RTC: unknown backend %s", spec);
+	return NULL;
+}
+
+} /* namespace i2c */
@@ -0,0 +1,24 @@
+/*
+ * rtc_backend.h
+ *
+ * Runtime selection of the RTC backend. All backends implement rtc_device and return the
+ * same snapshot, so the choice can be made per host:
+ *
+ *    i2c:<bus>:<address>   raw i2c-dev access with the template driver (default i2c:1:0x68)
+ *    rtc:<path> or <path>  kernel RTC driver, e.g. /dev/rtc0
+ *    auto                  the kernel driver when rtc0 is a DS1307/DS3231 bound to the kernel,
+ *                          raw i2c-dev access otherwise
+ */
+
+#ifndef RTC_BACKEND_H_
+#define RTC_BACKEND_H_
+
+#include "rtc_device.h"
+
+namespace i2c {
+
+rtc_device* rtc_backend_open(const char *spec);
+
+} /* namespace i2c */
+
+#endif /* RTC_BACKEND_H_ */
@@ -0,0 +1,75 @@
+/*
+ * rtc_device.h
+ *
+ * Thin type erased wrapper over the RTC drivers for code that selects the driver at
+ * runtime. The virtual call happens once per operation at this boundary, the driver
+ * underneath stays fully inlined.
+ *
+ *    rtc_device *rtc = new rtc_device_model<tmpl::ds3231<linux_i2c_transport> >(1, 0x68);
+ */
+
+#ifndef RTC_DEVICE_H_
+#define RTC_DEVICE_H_
+
+#include <utility>
+#include <chrono>
+#include "rtc_snapshot.h"
+
+namespace i2c {
+
+/**
+ * @class rtc_device
+ * @brief Runtime interface to an RTC
+ */
+class rtc_device {
+public:
+	virtual int readSnapshot(rtc_snapshot &snapshot) = 0;
+	virtual int readTemperature(float &temperature) = 0;
+	virtual int setTime(std::chrono::system_clock::time_point time, bool alignToSecond = false) = 0;
+
+	//reads only as much as needed to see the seconds change, used to poll for the second edge.
+	//Backends without a shorter read take the seconds from a snapshot.
+	virtual int readSeconds(unsigned int &seconds, int64_t &monotonicNs) {
+		rtc_snapshot snapshot;
+		if(this->readSnapshot(snapshot)) return 1;
+		seconds = snapshot.seconds;
+		monotonicNs = snapshot.monotonicNs;
+		return 0;
+	}
+
+	//backends that deliver second ticks return a descriptor that is readable on each edge,
+	//acknowledgeTick() consumes it. -1 means the caller has to time the ticks itself.
+	virtual int enableTicks() { return -1; }
+	virtual int acknowledgeTick() { return 0; }
+
+	virtual ~rtc_device() {}
+};
+
+/**
+ * @class rtc_device_model
+ * @brief Adapts any driver with readSnapshot()/readTemperature()/setTime()/readSeconds() methods
+ * (tmpl::ds3231, i2c_device_ds3231) to rtc_device
+ */
+template<class Driver>
+class rtc_device_model : public rtc_device {
+private:
+	Driver driver;
+public:
+	template<class... Args>
+	explicit rtc_device_model(Args&&... args): driver(std::forward<Args>(args)...) {}
+
+	Driver& get() { return driver; }
+
+	virtual int readSnapshot(rtc_snapshot &snapshot) { return driver.readSnapshot(snapshot); }
+	virtual int readTemperature(float &temperature) { return driver.readTemperature(temperature); }
+	virtual int setTime(std::chrono::system_clock::time_point time, bool alignToSecond = false) {
+		return driver.setTime(time, alignToSecond);
+	}
+	virtual int readSeconds(unsigned int &seconds, int64_t &monotonicNs) {
+		return driver.readSeconds(seconds, monotonicNs);
+	}
+};
+
+} /* namespace i2c */
+
+#endif /* RTC_DEVICE_H_ */
@@ -0,0 +1,204 @@
+#include "rtc_kernel_device.h"
+#include "ds3231_registers.h"
+#include "i2c_diag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/rtc.h>
+
+namespace i2c {
+
+/**
+ * Constructor for the kernel RTC backend. Opens the RTC device, which is closed by the destructor.
+ * @param path the RTC device (for example: /dev/rtc0), or a stub file for testing
+ */
+rtc_kernel_device::rtc_kernel_device(const char *path) {
+	this->file = -1;
+	this->ticking = false;
+	this->temperaturePath[0] = '\0';
+	this->temperature = 0;
+	this->temperatureNs = 0;
+	snprintf(this->path, sizeof(this->path), "%s", path);
+	this->open();
+}
+
+/**
+ * Open the RTC device. The RTC ioctls work on a read only descriptor.
+ * @return 1 on failure to open the device, 0 on success.
+ */
+int rtc_kernel_device::open(){
+	if((this->file=::open(this->path, O_RDONLY | O_CLOEXEC)) < 0){
+		diagError("RTC: failed to open the device");
+		return 1;
+	}
+	return 0;
+}
+
+int rtc_kernel_device::control(unsigned long request, void *argument){
+	return ioctl(this->file, request, argument);
+}
+
+/**
+ * Fill the time fields of a snapshot from the kernel representation. The kernel always works in
+ * 24hr mode, and the raw registers are encoded from the time so that readers of the snapshot
+ * see the same layout as with the I2C backend.
+ * @param time the time returned by RTC_RD_TIME
+ * @param snapshot the snapshot to fill
+ */
+void rtc_kernel_device::decodeTime(const struct rtc_time &time, rtc_snapshot &snapshot){
+	memset(&snapshot, 0, sizeof(snapshot));
+	ds3231_encode(time.tm_year + 1900, time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec,
+			false, snapshot.registers);
+	snapshot.seconds = time.tm_sec;
+	snapshot.minutes = time.tm_min;
+	snapshot.hours = time.tm_hour;
+	snapshot.day = (time.tm_wday == 0) ? 7 : time.tm_wday;   //MONDAY = 1 ... SUNDAY = 7
+	snapshot.date = time.tm_mday;
+	snapshot.month = time.tm_mon + 1;
+	snapshot.year = time.tm_year + 1900;
+	snapshot.hourMode = 0;
+	snapshot.pm = 0;
+}
+
+/**
+ * Read the time through RTC_RD_TIME. When a hwmon input is set the snapshot carries the last
+ * temperature reading, which is refreshed every RTC_TEMPERATURE_PERIOD_NS so that the other
+ * ticks stay at one bus transaction.
+ * Status, control and aging registers are not available through the kernel and read as 0.
+ * @param snapshot the snapshot to fill
+ * @return 1 on failure to read the time, 0 on success.
+ */
+int rtc_kernel_device::readSnapshot(rtc_snapshot &snapshot){
+	struct rtc_time time;
+	struct timespec before, after, realtime;
+
+	memset(&time, 0, sizeof(time));
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	if(this->control(RTC_RD_TIME, &time) < 0){
+		diagError("RTC: failed to read the time");
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	clock_gettime(CLOCK_REALTIME, &realtime);
+
+	decodeTime(time, snapshot);
+	ds3231_stamp(snapshot, before, after, realtime);
+
+	if(this->temperaturePath[0] != '\0'){
+		float temperature;
+		if(this->temperatureNs == 0 || snapshot.monotonicNs - this->temperatureNs >= RTC_TEMPERATURE_PERIOD_NS){
+			this->readTemperature(temperature);
+		}
+		if(this->temperatureNs != 0){
+			snapshot.temperature = this->temperature;
+			snapshot.temperatureQuarters = (int16_t)(this->temperature * 4);
+		}
+	}
+	return 0;
+}
+
+void rtc_kernel_device::setTemperaturePath(const char *path){
+	snprintf(this->temperaturePath, sizeof(this->temperaturePath), "%s", path);
+}
+
+/**
+ * Read the temperature from the hwmon input of the device, see setTemperaturePath(). The
+ * reading also refreshes the temperature carried by the snapshots.
+ * @return 1 if no input is set or it cannot be read, 0 on success.
+ */
+int rtc_kernel_device::readTemperature(float &temperature){
+	if(this->temperaturePath[0] == '\0') return 1;
+	FILE *input = fopen(this->temperaturePath, "r");
+	if(input == NULL) return 1;
+	long millidegrees;
+	int count = fscanf(input, "%ld", &millidegrees);
+	fclose(input);
+	if(count != 1) return 1;
+	temperature = millidegrees / 1000.0f;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	this->temperature = temperature;
+	this->temperatureNs = ds3231_timespecToNs(now);
+	return 0;
+}
+
+/**
+ * Set the time through RTC_SET_TIME, validated on the host like the I2C backend.
+ * @param time the time to set (UTC), taken as the time on entry
+ * @param alignToSecond delay the write to the next whole second of time
+ * @return 1 if the time is out of range or the write failed, 0 on success.
+ */
+int rtc_kernel_device::setTime(std::chrono::system_clock::time_point time, bool alignToSecond){
+	int64_t anchor = ds3231_monotonicNs();
+	unsigned char registers[7];
+	std::chrono::system_clock::time_point edge = alignToSecond ? ds3231_nextEdge(time) : time;
+	if(ds3231_encode(edge, false, registers)){
+		diag(DIAG_ERROR, "Time out of range (2000 - 2199)");
+		return 1;
+	}
+
+	//converted before waiting, only the ioctl follows the edge
+	time_t seconds = std::chrono::system_clock::to_time_t(edge);
+	struct tm utc;
+	gmtime_r(&seconds, &utc);
+	struct rtc_time value;
+	memset(&value, 0, sizeof(value));
+	value.tm_sec = utc.tm_sec;
+	value.tm_min = utc.tm_min;
+	value.tm_hour = utc.tm_hour;
+	value.tm_mday = utc.tm_mday;
+	value.tm_mon = utc.tm_mon;
+	value.tm_year = utc.tm_year;
+	value.tm_wday = utc.tm_wday;
+	value.tm_yday = utc.tm_yday;
+	if(alignToSecond) ds3231_waitForEdge(time, anchor);
+	if(this->control(RTC_SET_TIME, &value) < 0){
+		diagError("RTC: failed to set the time");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Enable the update interrupt, the device becomes readable on every second edge
+ * @return the descriptor to wait on, -1 if the driver does not support update interrupts.
+ */
+int rtc_kernel_device::enableTicks(){
+	if(this->file < 0) return -1;
+	if(!this->ticking){
+		if(this->control(RTC_UIE_ON, NULL) < 0) return -1;
+		this->ticking = true;
+	}
+	return this->file;
+}
+
+/**
+ * Consume a pending tick. The driver reports the number of interrupts since the last read in
+ * the upper bytes and the interrupt type in the low byte.
+ * @return the number of ticks, 0 on failure.
+ */
+int rtc_kernel_device::acknowledgeTick(){
+	unsigned long data;
+	if(::read(this->file, &data, sizeof(data)) != sizeof(data)) return 0;
+	return (int)(data >> 8);
+}
+
+void rtc_kernel_device::close(){
+	if(this->ticking) this->control(RTC_UIE_OFF, NULL);
+	this->ticking = false;
+	if(this->file != -1) ::close(this->file);
+	this->file = -1;
+}
+
+/**
+ * Closes the device on destruction, provided that it has not already been closed. The update
+ * interrupt is switched off first.
+ */
+rtc_kernel_device::~rtc_kernel_device() {
+	if(this->file != -1) this->close();
+}
+
+} /* namespace i2c */
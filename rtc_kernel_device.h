@@ -0,0 +1,61 @@
+/*
+ * rtc_kernel_device.h
+ *
+ * RTC backend that goes through the kernel RTC driver (/dev/rtcN) instead of raw i2c-dev
+ * access. Use it on hosts where rtc-ds1307 (which also handles the DS3231) is bound to the
+ * device: the kernel owns the bus and delivers the second ticks as update interrupts.
+ */
+
+#ifndef RTC_KERNEL_DEVICE_H_
+#define RTC_KERNEL_DEVICE_H_
+
+#include "rtc_device.h"
+
+#define RTC_0 "/dev/rtc0"
+
+//the DS3231 converts the temperature every 64 seconds, the hwmon input is read no more often
+#define RTC_TEMPERATURE_PERIOD_NS 64000000000LL
+
+struct rtc_time;
+
+namespace i2c {
+
+/**
+ * @class rtc_kernel_device
+ * @brief rtc_device over the Linux RTC interface (RTC_RD_TIME, RTC_SET_TIME, RTC_UIE_ON)
+ */
+class rtc_kernel_device : public rtc_device {
+private:
+	char path[64];
+	char temperaturePath[128];
+	int file;
+	bool ticking;
+	float temperature;              //last hwmon reading
+	int64_t temperatureNs;          //CLOCK_MONOTONIC of the last hwmon reading, 0 before the first
+
+protected:
+	//all ioctls go through here so that a stub can stand in for the driver
+	virtual int control(unsigned long request, void *argument);
+
+public:
+	rtc_kernel_device(const char *path = RTC_0);
+	virtual int open();
+
+	static void decodeTime(const struct rtc_time &time, rtc_snapshot &snapshot);
+
+	virtual int readSnapshot(rtc_snapshot &snapshot);
+	virtual int readTemperature(float &temperature);
+	virtual int setTime(std::chrono::system_clock::time_point time, bool alignToSecond = false);
+	virtual int enableTicks();
+	virtual int acknowledgeTick();
+
+	//hwmon input (millidegrees) of the device, the RTC interface has no temperature
+	void setTemperaturePath(const char *path);
+
+	virtual void close();
+	virtual ~rtc_kernel_device();
+};
+
+} /* namespace i2c */
+
+#endif /* RTC_KERNEL_DEVICE_H_ */
@@ -0,0 +1,333 @@
+#include "rtc_scheduler.h"
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+namespace i2c {
+
+#define NS_PER_SECOND 1000000000LL
+
+//polling interval and window used to find the RTC second edge
+#define EDGE_POLL_NS     1000000LL
+#define EDGE_WINDOW_NS   5000000LL
+
+static int64_t monotonicNs(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+static void sleepUntil(int64_t deadlineNs){
+	struct timespec deadline;
+	deadline.tv_sec = deadlineNs / NS_PER_SECOND;
+	deadline.tv_nsec = deadlineNs % NS_PER_SECOND;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+}
+
+/**
+ * Constructor for the scheduler. The epoll instance and the timer are created here, the timer
+ * is armed by alignToEdge().
+ * @param rtc the RTC that provides the ticks and the snapshots
+ * @param guardNs time after the second edge at which the registers are read, this covers the
+ * uncertainty of the measured edge
+ */
+rtc_scheduler::rtc_scheduler(rtc_device &rtc, int64_t guardNs): rtc(rtc) {
+	this->guardNs = guardNs;
+	this->running = false;
+	this->edgeNs = this->nextDeadlineNs = this->edgeErrorNs = this->driftNs = this->driftErrorNs = 0;
+	this->polling = false;
+	this->pollSeconds = -1;
+	this->pollBeforeNs = this->pollTimeoutNs = 0;
+	this->expectedSeconds = -1;
+	this->ticker = -1;
+	this->lastTickNs = 0;
+	this->ticks = this->missed = this->slips = 0;
+	this->maxLatencyNs = this->totalLatencyNs = 0;
+
+	this->epoll = epoll_create1(EPOLL_CLOEXEC);
+	this->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	this->edgeTimer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(this->epoll < 0 || this->timer < 0 || this->edgeTimer < 0){
+		perror("Scheduler: failed to create the event loop\n");
+		return;
+	}
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.fd = this->timer;
+	if(epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->timer, &event) < 0){
+		perror("Scheduler: failed to add the timer\n");
+	}
+	event.data.fd = this->edgeTimer;
+	if(epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->edgeTimer, &event) < 0){
+		perror("Scheduler: failed to add the edge timer\n");
+	}
+}
+
+/**
+ * Add a periodic job. Jobs with the same period run on the same tick, in the order they were
+ * added, and all receive the snapshot read at the start of the tick.
+ * @param name the name of the job, for diagnostics
+ * @param period the period in ticks (seconds)
+ * @param function the job
+ * @return 1 if the period is invalid, 0 on success.
+ */
+int rtc_scheduler::addTask(const char *name, unsigned int period, task_function function){
+	if(period == 0) return 1;
+	task job = {name, period, function};
+	this->tasks.push_back(job);
+	return 0;
+}
+
+/**
+ * Arm the timer for a deadline and one second intervals after it
+ * @return 1 on failure, 0 on success.
+ */
+int rtc_scheduler::arm(int64_t deadlineNs){
+	struct itimerspec spec;
+	spec.it_value.tv_sec = deadlineNs / NS_PER_SECOND;
+	spec.it_value.tv_nsec = deadlineNs % NS_PER_SECOND;
+	spec.it_interval.tv_sec = 1;
+	spec.it_interval.tv_nsec = 0;
+	if(timerfd_settime(this->timer, TFD_TIMER_ABSTIME, &spec, NULL) < 0){
+		perror("Scheduler: failed to arm the timer\n");
+		return 1;
+	}
+	this->nextDeadlineNs = deadlineNs;
+	return 0;
+}
+
+/**
+ * Record a measured RTC second edge and the phase change since the previous one
+ * @param beforeNs CLOCK_MONOTONIC of the last read before the edge
+ * @param afterNs CLOCK_MONOTONIC of the first read after the edge
+ */
+void rtc_scheduler::setEdge(int64_t beforeNs, int64_t afterNs){
+	int64_t previousEdge = this->edgeNs, previousError = this->edgeErrorNs;
+
+	this->edgeNs = beforeNs + (afterNs - beforeNs) / 2;
+	this->edgeErrorNs = (afterNs - beforeNs) / 2;
+	if(previousEdge != 0){
+		//phase change of the RTC against the host clock since the last alignment
+		int64_t offset = (this->edgeNs - previousEdge) % NS_PER_SECOND;
+		if(offset > NS_PER_SECOND / 2) offset -= NS_PER_SECOND;
+		this->driftNs = offset;
+		this->driftErrorNs = previousError + this->edgeErrorNs;
+	}
+}
+
+/**
+ * Measure the RTC second edge against the host monotonic clock and align the ticks to it.
+ * The seconds register alone (rtc_device::readSeconds()) is polled every EDGE_POLL_NS until it
+ * changes. When an edge is already
+ * known the polling only starts EDGE_WINDOW_NS before the predicted edge.
+ * This blocks for up to a second and the ticks in between are lost, so it is only used before
+ * the loop runs. Jobs call requestResync() instead.
+ * Nothing is measured when the backend delivers its own ticks, these are the edges.
+ * @return 1 if the RTC could not be read or did not tick, RTC_SCHEDULER_BACKEND_TICKS when the
+ * backend delivers the ticks, 0 on success.
+ */
+int rtc_scheduler::alignToEdge(){
+	if(this->ticker >= 0) return RTC_SCHEDULER_BACKEND_TICKS;
+	unsigned int first, seconds;
+	int64_t before, after;
+	int64_t previousEdge = this->edgeNs;
+
+	if(previousEdge != 0){
+		int64_t predicted = previousEdge + ((monotonicNs() - previousEdge) / NS_PER_SECOND + 1) * NS_PER_SECOND;
+		sleepUntil(predicted - EDGE_WINDOW_NS);
+	}
+	if(this->rtc.readSeconds(first, before)) return 1;
+
+	int64_t timeout = before + 2 * NS_PER_SECOND;
+	while(true){
+		sleepUntil(monotonicNs() + EDGE_POLL_NS);
+		if(this->rtc.readSeconds(seconds, after)) return 1;
+		if(seconds != first) break;
+		before = after;
+		if(before > timeout){
+			fprintf(stderr, "Scheduler: the RTC is not ticking\n");
+			return 1;
+		}
+	}
+
+	this->setEdge(before, after);
+	this->expectedSeconds = (seconds + 1) % 60;
+	return this->arm(this->edgeNs + NS_PER_SECOND + this->guardNs);
+}
+
+/**
+ * Start polling the seconds register from the edge timer, one read every EDGE_POLL_NS
+ * @param startNs CLOCK_MONOTONIC of the first read
+ * @return 1 if the timer could not be armed, 0 on success.
+ */
+int rtc_scheduler::startPolling(int64_t startNs){
+	struct itimerspec spec;
+	spec.it_value.tv_sec = startNs / NS_PER_SECOND;
+	spec.it_value.tv_nsec = startNs % NS_PER_SECOND;
+	spec.it_interval.tv_sec = 0;
+	spec.it_interval.tv_nsec = EDGE_POLL_NS;
+	if(timerfd_settime(this->edgeTimer, TFD_TIMER_ABSTIME, &spec, NULL) < 0){
+		perror("Scheduler: failed to arm the edge timer\n");
+		return 1;
+	}
+	this->polling = true;
+	this->pollSeconds = -1;
+	this->pollTimeoutNs = startNs + 2 * NS_PER_SECOND;
+	return 0;
+}
+
+/**
+ * Measure the RTC second edge again without blocking the loop. The seconds register is polled
+ * from the edge timer starting EDGE_WINDOW_NS before the predicted edge, the ticks keep running
+ * and the tick timer is moved onto the new edge once it is found. The resync handler is called
+ * when the measurement completes.
+ * @return 1 if no edge has been measured yet or the timer could not be armed,
+ * RTC_SCHEDULER_BACKEND_TICKS when the backend delivers the ticks, 0 when the resync is under way.
+ */
+int rtc_scheduler::requestResync(){
+	if(this->ticker >= 0) return RTC_SCHEDULER_BACKEND_TICKS;
+	if(this->edgeNs == 0) return 1;
+	if(this->polling) return 0;
+	//the first predicted edge that leaves room for the whole window
+	int64_t now = monotonicNs();
+	int64_t predicted = this->edgeNs + ((now + EDGE_WINDOW_NS - this->edgeNs) / NS_PER_SECOND + 1) * NS_PER_SECOND;
+	return this->startPolling(predicted - EDGE_WINDOW_NS);
+}
+
+/**
+ * Handle an edge timer expiration: one read of the seconds register. When the seconds register has changed
+ * since the previous read the edge is recorded and the tick timer is moved onto it.
+ */
+void rtc_scheduler::pollEdge(){
+	uint64_t expirations;
+	if(::read(this->edgeTimer, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+
+	unsigned int seconds;
+	int64_t readNs;
+	if(this->rtc.readSeconds(seconds, readNs) == 0){
+		if(this->pollSeconds >= 0 && (int)seconds != this->pollSeconds){
+			struct itimerspec stop = {};
+			timerfd_settime(this->edgeTimer, 0, &stop, NULL);
+			this->polling = false;
+			this->setEdge(this->pollBeforeNs, readNs);
+
+			//re-arming discards a pending expiration, so a tick that is due is run first
+			if(::read(this->timer, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0){
+				this->tick(expirations);
+			}
+			//the tick of the second that has just started may already have run
+			int64_t deadline = this->edgeNs + this->guardNs;
+			if(this->expectedSeconds == (int)(seconds + 1) % 60) deadline += NS_PER_SECOND;
+			else this->expectedSeconds = seconds;
+			this->arm(deadline);
+
+			if(this->resyncDone) this->resyncDone(this->driftNs, this->driftErrorNs);
+			return;
+		}
+		this->pollSeconds = seconds;
+		this->pollBeforeNs = readNs;
+	}
+	if(monotonicNs() > this->pollTimeoutNs){
+		fprintf(stderr, "Scheduler: the RTC is not ticking\n");
+		struct itimerspec stop = {};
+		timerfd_settime(this->edgeTimer, 0, &stop, NULL);
+		this->polling = false;
+	}
+}
+
+/**
+ * Handle a timer expiration: read the RTC once, check that it advanced by one second and run
+ * the jobs that are due.
+ * @param expirations number of timer periods since the last tick, more than one means that
+ * ticks were missed
+ */
+void rtc_scheduler::tick(uint64_t expirations){
+	int64_t latency = monotonicNs() - (this->nextDeadlineNs + (int64_t)(expirations - 1) * NS_PER_SECOND);
+	this->nextDeadlineNs += expirations * NS_PER_SECOND;
+	this->missed += expirations - 1;
+	if(latency > this->maxLatencyNs) this->maxLatencyNs = latency;
+	this->totalLatencyNs += latency;
+	unsigned long index = this->ticks++;
+
+	rtc_snapshot snapshot;
+	if(this->rtc.readSnapshot(snapshot)) return;
+
+	//the registers must have ticked exactly once since the previous tick
+	bool slipped = (expirations == 1 && this->expectedSeconds >= 0 && snapshot.seconds != this->expectedSeconds);
+	this->expectedSeconds = (snapshot.seconds + 1) % 60;
+
+	for(size_t i=0; i<this->tasks.size(); i++){
+		if(index % this->tasks[i].period == 0) this->tasks[i].function(snapshot);
+	}
+
+	if(slipped){
+		this->slips++;
+		//the edge has moved by an unknown amount, poll for it from now on
+		if(this->ticker < 0 && !this->polling) this->startPolling(monotonicNs());
+	}
+}
+
+/**
+ * Run the event loop. The process sleeps in epoll_wait() between ticks.
+ * @param maxTicks stop after this many ticks, 0 to run until stop() is called
+ * @return 1 on failure of the event loop, 0 when stopped.
+ */
+int rtc_scheduler::run(unsigned long maxTicks){
+	if(this->ticker < 0 && this->edgeNs == 0){
+		//prefer the ticks of the backend, the timer is aligned by polling otherwise
+		int descriptor = this->rtc.enableTicks();
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.fd = descriptor;
+		if(descriptor >= 0 && epoll_ctl(this->epoll, EPOLL_CTL_ADD, descriptor, &event) == 0){
+			this->ticker = descriptor;
+		}
+		else if(this->alignToEdge()) return 1;
+	}
+	this->running = true;
+	unsigned long start = this->ticks;
+
+	while(this->running && (maxTicks == 0 || this->ticks - start < maxTicks)){
+		struct epoll_event events[4];
+		int count = epoll_wait(this->epoll, events, 4, -1);
+		if(count < 0){
+			if(errno == EINTR) continue;
+			perror("Scheduler: epoll_wait failed\n");
+			return 1;
+		}
+		for(int i=0; i<count; i++){
+			if(events[i].data.fd == this->ticker){
+				int pending = this->rtc.acknowledgeTick();
+				if(pending <= 0) continue;
+				//the edge itself is not known, the latency is the jitter against the previous tick
+				int64_t now = monotonicNs();
+				this->nextDeadlineNs = this->lastTickNs ? this->lastTickNs + NS_PER_SECOND : now;
+				this->lastTickNs = now;
+				this->tick(pending);
+				continue;
+			}
+			if(events[i].data.fd == this->edgeTimer){
+				this->pollEdge();
+				continue;
+			}
+			if(events[i].data.fd != this->timer) continue;
+			uint64_t expirations;
+			if(::read(this->timer, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0){
+				this->tick(expirations);
+			}
+		}
+	}
+	this->running = false;
+	return 0;
+}
+
+rtc_scheduler::~rtc_scheduler() {
+	if(this->timer >= 0) ::close(this->timer);
+	if(this->edgeTimer >= 0) ::close(this->edgeTimer);
+	if(this->epoll >= 0) ::close(this->epoll);
+}
+
+} /* namespace i2c */
@@ -0,0 +1,99 @@
+/*
+ * rtc_scheduler.h
+ *
+ * Event loop that runs periodic jobs on the second ticks of the RTC. The loop waits in
+ * epoll on a timerfd armed with absolute deadlines just after each RTC second edge, so the
+ * process sleeps between ticks and the deadlines do not drift. When the backend delivers its
+ * own ticks (the kernel RTC update interrupt) the loop waits on those instead. All jobs due
+ * on a tick share the snapshot of a single burst read.
+ *
+ * A resync measures the edge again from a second timer in the same loop, one read per
+ * millisecond around the predicted edge, so the ticks keep running while it is measured. The
+ * edge is polled with a read of the seconds register alone (rtc_device::readSeconds()), which
+ * keeps the bracket close to the polling interval and the bus load low.
+ */
+
+#ifndef RTC_SCHEDULER_H_
+#define RTC_SCHEDULER_H_
+
+#include <functional>
+#include <vector>
+#include "rtc_device.h"
+
+//returned by alignToEdge() and requestResync() when the backend delivers the ticks, there is
+//no edge to measure
+#define RTC_SCHEDULER_BACKEND_TICKS 2
+
+namespace i2c {
+
+/**
+ * @class rtc_scheduler
+ * @brief Coalesces periodic jobs onto RTC aligned ticks and measures the tick phase error
+ */
+class rtc_scheduler {
+public:
+	typedef std::function<void(const rtc_snapshot&)> task_function;
+	//called when a resync completes with the phase change of the edge and its uncertainty
+	typedef std::function<void(int64_t driftNs, int64_t errorNs)> resync_function;
+
+private:
+	struct task {
+		const char *name;
+		unsigned int period;        //in ticks
+		task_function function;
+	};
+
+	rtc_device &rtc;
+	int epoll, timer;
+	int edgeTimer;                  //one seconds read per EDGE_POLL_NS while a resync is polling
+	int ticker;                     //tick descriptor of the backend, -1 when the timer is used
+	int64_t lastTickNs;
+	bool running;
+	int64_t guardNs;                //delay after the edge before the registers are read
+	int64_t edgeNs;                 //CLOCK_MONOTONIC of a measured RTC second edge
+	int64_t edgeErrorNs;            //half of the polling interval that bracketed the edge
+	int64_t driftNs;                //phase change of the RTC edge between the last two alignments
+	int64_t driftErrorNs;           //uncertainty of driftNs, the sum of both edge errors
+	bool polling;                   //a resync is measuring the edge
+	int pollSeconds;                //seconds register at the previous poll, -1 before the first
+	int64_t pollBeforeNs, pollTimeoutNs;
+	resync_function resyncDone;
+	int64_t nextDeadlineNs;
+	int expectedSeconds;            //-1 when unknown
+	std::vector<task> tasks;
+
+	unsigned long ticks, missed, slips;
+	int64_t maxLatencyNs, totalLatencyNs;
+
+	int arm(int64_t deadlineNs);
+	void tick(uint64_t expirations);
+	void setEdge(int64_t beforeNs, int64_t afterNs);
+	int startPolling(int64_t startNs);
+	void pollEdge();
+
+public:
+	rtc_scheduler(rtc_device &rtc, int64_t guardNs = 2000000);
+
+	int addTask(const char *name, unsigned int period, task_function function);
+	int alignToEdge();
+	int requestResync();
+	void setResyncHandler(resync_function function) { resyncDone = function; }
+	int run(unsigned long maxTicks = 0);
+	void stop() { running = false; }
+
+	unsigned long getTicks() const { return ticks; }
+	unsigned long getMissed() const { return missed; }
+	unsigned long getSlips() const { return slips; }
+	int64_t getMaxLatencyNs() const { return maxLatencyNs; }
+	int64_t getMeanLatencyNs() const { return ticks ? totalLatencyNs / (int64_t)ticks : 0; }
+	int64_t getEdgeNs() const { return edgeNs; }
+	int64_t getEdgeErrorNs() const { return edgeErrorNs; }
+	int64_t getDriftNs() const { return driftNs; }
+	int64_t getDriftErrorNs() const { return driftErrorNs; }
+
+	virtual ~rtc_scheduler();
+};
+
+} /* namespace i2c */
+
+#endif /* RTC_SCHEDULER_H_ */
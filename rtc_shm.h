@@ -0,0 +1,223 @@
+/*
+ * rtc_shm.h
+ *
+ * Shared memory page used by the RTC time service (rtc_shmd). The daemon owns the
+ * DS3231 and publishes the latest snapshot into a POSIX shared memory object that is
+ * guarded by a sequence lock. Readers only map the page: a read is two loads of the
+ * sequence counter and a copy, with no system calls and no bus traffic, so any number
+ * of readers costs the same bus load as one.
+ *
+ * Header only so that clients do not need to link against the driver.
+ */
+
+#ifndef RTC_SHM_H_
+#define RTC_SHM_H_
+
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include "rtc_snapshot.h"
+
+#define RTC_SHM_NAME     "/rtc_ds3231"
+#define RTC_SHM_MAGIC    0x52544353   //"RTCS"
+#define RTC_SHM_VERSION  1
+
+namespace i2c {
+
+/**
+ * @struct rtc_shm_page
+ * @brief Layout of the shared memory object. The sequence counter is odd while the
+ * publisher is updating the snapshot and even when the snapshot is consistent.
+ */
+struct rtc_shm_page {
+	uint32_t magic;
+	uint32_t version;
+	std::atomic<uint32_t> sequence;
+	uint32_t publisherPid;
+	uint64_t updates;          //number of snapshots published
+	int64_t  periodNs;         //publishing period, used by readers to detect a stale page
+	rtc_snapshot snapshot;
+};
+
+/**
+ * @class rtc_shm_reader
+ * @brief Maps the time service page read-only and reads consistent snapshots from it
+ */
+class rtc_shm_reader {
+private:
+	const rtc_shm_page *page;
+public:
+	rtc_shm_reader(): page(NULL) {}
+
+	/**
+	 * Map the shared memory page published by the time service
+	 * @param name the name of the shared memory object
+	 * @return 1 on failure to open or map the page, 0 on success.
+	 */
+	int open(const char *name = RTC_SHM_NAME){
+		int fd = shm_open(name, O_RDONLY, 0);
+		if(fd < 0){
+			perror("RTC SHM: failed to open the shared memory page\n");
+			return 1;
+		}
+		void *map = mmap(NULL, sizeof(rtc_shm_page), PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);   //the mapping stays valid after the descriptor is closed
+		if(map == MAP_FAILED){
+			perror("RTC SHM: failed to map the shared memory page\n");
+			return 1;
+		}
+		this->page = static_cast<const rtc_shm_page*>(map);
+		if(this->page->magic != RTC_SHM_MAGIC || this->page->version != RTC_SHM_VERSION){
+			fprintf(stderr, "RTC SHM: page has an unknown layout\n");
+			this->close();
+			return 1;
+		}
+		return 0;
+	}
+
+	/**
+	 * Copy the latest snapshot out of the page. The copy is retried while the publisher
+	 * is in the middle of an update.
+	 * @param snapshot the snapshot to fill
+	 * @param maxRetries the number of attempts before giving up
+	 * @return 1 if no consistent snapshot could be read (or nothing was published yet), 0 on success.
+	 */
+	int read(rtc_snapshot &snapshot, unsigned int maxRetries = 1000) const {
+		if(this->page == NULL) return 1;
+		for(unsigned int i=0; i<maxRetries; i++){
+			uint32_t begin = this->page->sequence.load(std::memory_order_acquire);
+			if(begin & 1) continue;       //writer active
+			memcpy(&snapshot, &this->page->snapshot, sizeof(rtc_snapshot));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint32_t end = this->page->sequence.load(std::memory_order_relaxed);
+			if(begin == end) return (begin == 0) ? 1 : 0;
+		}
+		return 1;
+	}
+
+	/**
+	 * Age of a snapshot relative to the host monotonic clock. clock_gettime() is served
+	 * by the vDSO, so this does not enter the kernel either.
+	 * @param snapshot a snapshot obtained from read()
+	 * @return the age in nanoseconds
+	 */
+	static int64_t ageNs(const rtc_snapshot &snapshot){
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec - snapshot.monotonicNs;
+	}
+
+	/**
+	 * A page is stale when the publisher has missed more than two periods
+	 * @param snapshot a snapshot obtained from read()
+	 */
+	bool isStale(const rtc_snapshot &snapshot) const {
+		return this->page == NULL || ageNs(snapshot) > 2 * this->page->periodNs;
+	}
+
+	void close(){
+		if(this->page != NULL) munmap(const_cast<rtc_shm_page*>(this->page), sizeof(rtc_shm_page));
+		this->page = NULL;
+	}
+
+	~rtc_shm_reader(){ this->close(); }
+};
+
+/**
+ * @class rtc_shm_writer
+ * @brief Creates the time service page and publishes snapshots into it. There is only one
+ * writer per page: the writer holds an exclusive flock on the shared memory object for as long
+ * as it is open, and a second writer is refused. The lock goes away with the process, so a
+ * page left behind by a publisher that died can be taken over.
+ */
+class rtc_shm_writer {
+private:
+	rtc_shm_page *page;
+	const char *name;
+	int fd;                    //kept open, it holds the lock
+public:
+	rtc_shm_writer(): page(NULL), name(NULL), fd(-1) {}
+
+	/**
+	 * Create the shared memory page, or take over a page whose publisher is gone
+	 * @param periodNs the publishing period advertised to readers
+	 * @param name the name of the shared memory object
+	 * @return 1 on failure to create or map the page or if another publisher owns it, 0 on success.
+	 */
+	int create(int64_t periodNs, const char *name = RTC_SHM_NAME){
+		int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+		if(fd < 0){
+			perror("RTC SHM: failed to create the shared memory page\n");
+			return 1;
+		}
+		if(flock(fd, LOCK_EX | LOCK_NB) < 0){
+			if(errno == EWOULDBLOCK) fprintf(stderr, "RTC SHM: the page is owned by another publisher\n");
+			else perror("RTC SHM: failed to lock the shared memory page\n");
+			::close(fd);
+			return 1;
+		}
+		if(ftruncate(fd, sizeof(rtc_shm_page)) < 0){
+			perror("RTC SHM: failed to size the shared memory page\n");
+			::close(fd);
+			return 1;
+		}
+		void *map = mmap(NULL, sizeof(rtc_shm_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(map == MAP_FAILED){
+			perror("RTC SHM: failed to map the shared memory page\n");
+			::close(fd);
+			return 1;
+		}
+		this->fd = fd;
+		this->page = static_cast<rtc_shm_page*>(map);
+		this->name = name;
+
+		//sequence 0 means nothing published yet, readers reject it
+		this->page->sequence.store(0, std::memory_order_relaxed);
+		this->page->updates = 0;
+		this->page->periodNs = periodNs;
+		this->page->publisherPid = getpid();
+		this->page->version = RTC_SHM_VERSION;
+		std::atomic_thread_fence(std::memory_order_release);
+		this->page->magic = RTC_SHM_MAGIC;
+		return 0;
+	}
+
+	/**
+	 * Publish a snapshot. The sequence is made odd before the copy and even after it so
+	 * that readers can detect a torn read and retry.
+	 * @param snapshot the snapshot to publish
+	 */
+	void publish(const rtc_snapshot &snapshot){
+		if(this->page == NULL) return;
+		uint32_t sequence = this->page->sequence.load(std::memory_order_relaxed);
+		this->page->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&this->page->snapshot, &snapshot, sizeof(rtc_snapshot));
+		this->page->updates++;
+		this->page->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	/**
+	 * Unmap the page. The object is removed as well when unlink is set, otherwise readers
+	 * keep seeing the last snapshot (and can detect that it is stale).
+	 */
+	void close(bool unlink = false){
+		if(this->page != NULL) munmap(this->page, sizeof(rtc_shm_page));
+		if(unlink && this->page != NULL && this->name != NULL) shm_unlink(this->name);
+		if(this->fd >= 0) ::close(this->fd);     //releases the lock
+		this->page = NULL;
+		this->fd = -1;
+	}
+
+	~rtc_shm_writer(){ this->close(); }
+};
+
+} /* namespace i2c */
+
+#endif /* RTC_SHM_H_ */
@@ -0,0 +1,31 @@
+/*
+ * rtc_shm_client.cpp
+ *
+ * Example client of the RTC time service. Reads the snapshot published by rtc_shmd
+ * without touching the I2C bus.
+ *
+ * build: g++ -O2 -std=c++11 rtc_shm_client.cpp -o rtc_shm_client -lrt
+ */
+
+#include <stdio.h>
+#include "rtc_shm.h"
+
+using namespace i2c;
+
+int main() {
+   rtc_shm_reader reader;
+   if(reader.open()) return 1;
+
+   rtc_snapshot snapshot;
+   if(reader.read(snapshot)){
+      fprintf(stderr, "No snapshot published yet\n");
+      return 1;
+   }
+
+   printf("%02d:%02d:%02d%s   %02d/%02d/%d\n", snapshot.hours, snapshot.minutes, snapshot.seconds,
+          snapshot.hourMode ? (snapshot.pm ? " PM" : " AM") : "", snapshot.date, snapshot.month, snapshot.year);
+   printf("The temperature is %.2f°C\n", snapshot.temperature);
+   if(snapshot.status & DS3231_STATUS_OSF) printf("Warning: oscillator stop flag is set, time may be invalid\n");
+   printf("Snapshot age %.3f ms%s\n", rtc_shm_reader::ageNs(snapshot) / 1e6, reader.isStale(snapshot) ? " (stale)" : "");
+   return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * rtc_shmd.cpp
+ *
+ * RTC time service. Owns the DS3231 on the bus and publishes a snapshot of the time,
+ * temperature and status flags into shared memory (see rtc_shm.h) at a fixed period.
+ * Clients read the page instead of opening the device, so the bus load does not grow
+ * with the number of readers.
+ *
+ * usage: rtc_shmd [backend] [period ms]
+ * where backend is auto (default), i2c:<bus>:<address> or a kernel RTC device such as /dev/rtc0,
+ * see rtc_backend.h
+ *
+ * build: g++ -O2 -std=c++11 rtc_shmd.cpp rtc_backend.cpp rtc_kernel_device.cpp i2c_diag.cpp -o rtc_shmd -lrt
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include "rtc_backend.h"
+#include "rtc_shm.h"
+
+using namespace std;
+using namespace i2c;
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int){ running = 0; }
+
+int main(int argc, char *argv[]) {
+   const char *backend = (argc > 1) ? argv[1] : "auto";
+   long periodMs = (argc > 2) ? strtol(argv[2], NULL, 0) : 1000;
+   if(periodMs <= 0) periodMs = 1000;
+
+   //the backends attach to the running clock, the time is not reset
+   rtc_device *rtc = rtc_backend_open(backend);
+   if(rtc == NULL) return 1;
+
+   rtc_shm_writer shm;
+   if(shm.create(periodMs * 1000000LL)){
+      delete rtc;
+      return 1;
+   }
+
+   signal(SIGINT, stop);
+   signal(SIGTERM, stop);
+
+   struct timespec next;
+   clock_gettime(CLOCK_MONOTONIC, &next);
+   rtc_snapshot snapshot;
+   unsigned long failures = 0;
+
+   while(running){
+      if(rtc->readSnapshot(snapshot) == 0) shm.publish(snapshot);
+      else if((++failures % 10) == 1) cerr << "rtc_shmd: failed to read the RTC (" << failures << " failures)" << endl;
+
+      //absolute deadlines so the period does not drift with the bus latency
+      next.tv_nsec += (periodMs % 1000) * 1000000L;
+      next.tv_sec += periodMs / 1000 + next.tv_nsec / 1000000000L;
+      next.tv_nsec %= 1000000000L;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+   }
+
+   shm.close(true);
+   delete rtc;
+   return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * rtc_snapshot.h
+ *
+ * Decoded view of the DS3231 register file taken in a single burst read.
+ * The structure only uses fixed width types so that it can be placed in
+ * shared memory and read by processes that do not link the driver.
+ */
+
+#ifndef RTC_SNAPSHOT_H_
+#define RTC_SNAPSHOT_H_
+
+#include <stdint.h>
+
+//Number of registers on the DS3231 (0x00 - 0x12)
+#define DS3231_REGISTER_COUNT      0x13
+
+//Control/status register (0x0F) flags
+#define DS3231_STATUS_OSF          0x80  //oscillator stop flag
+#define DS3231_STATUS_EN32KHZ      0x08  //32kHz output enabled
+#define DS3231_STATUS_BSY          0x04  //temperature conversion busy
+#define DS3231_STATUS_A2F          0x02  //alarm 2 flag
+#define DS3231_STATUS_A1F          0x01  //alarm 1 flag
+
+namespace i2c {
+
+/**
+ * @struct rtc_snapshot
+ * @brief Time, temperature and status decoded from one burst read of the RTC, together with
+ * the host clocks sampled around the read so the RTC time can be related to the host time
+ */
+struct rtc_snapshot {
+	uint8_t  registers[DS3231_REGISTER_COUNT]; //raw register file as read from the device
+
+	//always in decimal format, hours as shown by the device (1-12 in 12hr mode)
+	uint8_t  seconds, minutes, hours, day, date, month;
+	uint8_t  hourMode;                //0 = 24hr, 1 = 12hr
+	uint8_t  pm;                      //only meaningful in 12hr mode
+	uint16_t year;
+
+	uint8_t  control;                 //register 0x0E
+	uint8_t  status;                  //register 0x0F, see DS3231_STATUS_* flags
+	int8_t   agingOffset;             //register 0x10
+	uint8_t  reserved;
+	int16_t  temperatureQuarters;     //temperature in 0.25°C steps
+	float    temperature;             //temperature in °C
+
+	int64_t  monotonicNs;             //CLOCK_MONOTONIC at the middle of the bus read
+	int64_t  realtimeNs;              //CLOCK_REALTIME at the same instant
+	uint32_t readLatencyNs;           //duration of the bus read
+	uint32_t reserved2;
+};
+
+} /* namespace i2c */
+
+#endif /* RTC_SNAPSHOT_H_ */
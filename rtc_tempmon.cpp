@@ -0,0 +1,60 @@
+/*
+ * rtc_tempmon.cpp
+ *
+ * Continuous thermal monitoring with the DS3231 temperature sensor. The temperature is
+ * sampled periodically and fed to temperature_stats, which keeps running statistics and
+ * raises threshold and rate alarms without storing the samples.
+ *
+ * usage: rtc_tempmon [period s] [low °C] [high °C] [rate °C/min]
+ *
+ * build: g++ -O2 -std=c++11 rtc_tempmon.cpp i2c_device.cpp i2c_device_ds3231.cpp i2c_diag.cpp temperature_stats.cpp -o rtc_tempmon
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include <time.h>
+#include "i2c_device_ds3231.h"
+#include "temperature_stats.h"
+
+using namespace std;
+using namespace i2c;
+
+int main(int argc, char *argv[]) {
+   long period = (argc > 1) ? strtol(argv[1], NULL, 0) : 10;
+   float low = (argc > 2) ? strtof(argv[2], NULL) : 0.0f;
+   float high = (argc > 3) ? strtof(argv[3], NULL) : 50.0f;
+   float rateLimit = (argc > 4) ? strtof(argv[4], NULL) : 2.0f;
+   if(period <= 0) period = 10;
+
+   i2c_device_ds3231 rtc(1, 0x68, false);
+   temperature_stats stats(0.1, 60);
+   stats.setThresholds(low, high, 0.5f);
+   stats.setRateLimit(rateLimit);
+
+   struct timespec next;
+   clock_gettime(CLOCK_MONOTONIC, &next);
+   cout << fixed << setprecision(2);
+
+   while(true){
+      float temperature;
+      if(rtc.readTemperature(temperature) == 0){
+         struct timespec now;
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         unsigned int raised = stats.addSample(temperature, (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec);
+
+         cout << "T=" << temperature << "°C ewma=" << stats.getEwma() << " mean=" << stats.getMean()
+              << " sd=" << stats.getStdDev() << " min=" << stats.getMin() << " max=" << stats.getMax()
+              << " rate=" << stats.getRate() << "°C/min p50=" << stats.getPercentile(temperature_stats::P50)
+              << " p99=" << stats.getPercentile(temperature_stats::P99) << endl;
+
+         if(raised & temperature_stats::ALARM_HIGH) cerr << "ALARM: temperature above " << high << "°C" << endl;
+         if(raised & temperature_stats::ALARM_LOW) cerr << "ALARM: temperature below " << low << "°C" << endl;
+         if(raised & temperature_stats::ALARM_RATE) cerr << "ALARM: temperature changing faster than " << rateLimit << "°C/min" << endl;
+      }
+
+      next.tv_sec += period;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+   }
+   return 0;
+}
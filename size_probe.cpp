@@ -0,0 +1,20 @@
+/*
+ * size_probe.cpp
+ *
+ * Minimal program that links the core driver, used by size_report.sh to compare the binary
+ * size and start-up time of the build profiles. Without arguments it returns straight away,
+ * so running it measures process start-up including static initialisation. The bus is only
+ * used when a bus number is given, and the time is not reset.
+ */
+
+#include <stdlib.h>
+#include "i2c_device_ds3231.h"
+
+int main(int argc, char *argv[]) {
+   if(argc > 1){
+      i2c::i2c_device_ds3231 rtc(strtoul(argv[1], NULL, 0), 0x68, false);
+      rtc.displayTimeAndDate();
+      rtc.displayTemperature();
+   }
+   return 0;
+}
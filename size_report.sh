@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# size_report.sh [revision]
+#
+# Builds size_probe.cpp against the core driver (i2c_device, i2c_device_ds3231) in the default
+# profile and in the embedded profile (no iostreams, no exceptions, no heap), then reports the
+# binary size, shared libraries, start-up time and peak RSS of each. The embedded profile links
+# libstdc++ statically: the only symbol it still takes from it is operator delete (for the
+# deleting virtual destructors), so the shared library is not loaded at start-up.
+# When a git revision is given, the core driver of that revision is built with the default
+# flags as well, for comparison with an older tree (it must have the three argument
+# i2c_device_ds3231 constructor).
+#
+# CXX, RUNS and the *_FLAGS variables can be overridden from the environment.
+
+set -e
+
+CXX=${CXX:-g++}
+RUNS=${RUNS:-500}
+DEFAULT_FLAGS=${DEFAULT_FLAGS:-"-std=c++11 -O2"}
+EMBEDDED_FLAGS=${EMBEDDED_FLAGS:-"-std=c++11 -Os -DI2C_EMBEDDED -fno-exceptions -fno-rtti -ffunction-sections -fdata-sections -Wl,--gc-sections -static-libstdc++ -static-libgcc"}
+CORE="i2c_device.cpp i2c_device_ds3231.cpp i2c_diag.cpp"
+
+TOP=$(cd "$(dirname "$0")" && pwd)
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# build <name> <source directory> <flags>
+build() {
+	sources=""
+	for file in $CORE; do
+		if [ -f "$2/$file" ]; then sources="$sources $2/$file"; fi
+	done
+	$CXX $3 -I"$2" "$TOP/size_probe.cpp" $sources -o "$OUT/$1"
+}
+
+now_ns() {
+	date +%s%N
+}
+
+report() {
+	binary="$OUT/$1"
+	set -- $(size "$binary" | tail -1)
+	text=$1; data=$2; bss=$3
+	bytes=$(wc -c < "$binary")
+	libs=$(readelf -d "$binary" | sed -n 's/.*Shared library: \[\(.*\)\]/\1/p' | tr '\n' ' ')
+
+	start=$(now_ns)
+	i=0
+	while [ $i -lt "$RUNS" ]; do "$binary"; i=$((i + 1)); done
+	startup=$(( ($(now_ns) - start) / RUNS / 1000 ))
+
+	rss="-"
+	if [ -x /usr/bin/time ]; then rss=$(/usr/bin/time -f %M "$binary" 2>&1 >/dev/null); fi
+
+	printf "%-10s %8s %6s %6s %9s %10s %8s  %s\n" "$(basename "$binary")" "$text" "$data" "$bss" "$bytes" "$startup" "$rss" "$libs"
+}
+
+build default "$TOP" "$DEFAULT_FLAGS"
+build embedded "$TOP" "$EMBEDDED_FLAGS"
+if [ -n "$1" ]; then
+	mkdir "$OUT/tree"
+	git -C "$TOP" archive "$1" | tar -x -C "$OUT/tree"
+	build revision "$OUT/tree" "$DEFAULT_FLAGS"
+fi
+
+printf "%-10s %8s %6s %6s %9s %10s %8s  %s\n" "profile" "text" "data" "bss" "file" "start(us)" "rss(kB)" "shared libraries"
+if [ -n "$1" ]; then report revision; fi
+report default
+report embedded
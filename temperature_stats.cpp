@@ -0,0 +1,237 @@
+#include "temperature_stats.h"
+#include <math.h>
+
+namespace i2c {
+
+/**
+ * Constructor for a P-square estimator
+ * @param p the quantile to track, between 0 and 1 (for example: 0.99)
+ */
+p2_quantile::p2_quantile(double p) {
+	this->p = p;
+	this->reset();
+}
+
+/**
+ * Forget all samples, the desired marker positions are restored to their initial values
+ */
+void p2_quantile::reset(){
+	this->count = 0;
+	for(int i=0; i<5; i++){
+		this->q[i] = 0;
+		this->n[i] = i;
+	}
+	this->np[0] = 0;
+	this->np[1] = 2 * p;
+	this->np[2] = 4 * p;
+	this->np[3] = 2 + 2 * p;
+	this->np[4] = 4;
+	this->dn[0] = 0;
+	this->dn[1] = p / 2;
+	this->dn[2] = p;
+	this->dn[3] = (1 + p) / 2;
+	this->dn[4] = 1;
+}
+
+/**
+ * Add a sample. The first five samples initialise the markers, after that each sample moves
+ * the markers by at most one position using a parabolic (or linear) height adjustment.
+ * @param x the sample value
+ */
+void p2_quantile::add(double x){
+	if(count < 5){
+		//insertion sort of the first five samples
+		int i = count++;
+		while(i > 0 && q[i-1] > x){
+			q[i] = q[i-1];
+			i--;
+		}
+		q[i] = x;
+		return;
+	}
+	count++;
+
+	int k;
+	if(x < q[0]){
+		q[0] = x;
+		k = 0;
+	}
+	else if(x >= q[4]){
+		q[4] = x;
+		k = 3;
+	}
+	else{
+		k = 0;
+		while(x >= q[k+1]) k++;
+	}
+
+	for(int i=k+1; i<5; i++) n[i]++;
+	for(int i=0; i<5; i++) np[i] += dn[i];
+
+	for(int i=1; i<4; i++){
+		double d = np[i] - n[i];
+		if((d >= 1 && n[i+1] - n[i] > 1) || (d <= -1 && n[i-1] - n[i] < -1)){
+			int ds = (d > 0) ? 1 : -1;
+			double qp = q[i] + ds / (n[i+1] - n[i-1]) *
+				((n[i] - n[i-1] + ds) * (q[i+1] - q[i]) / (n[i+1] - n[i]) +
+				 (n[i+1] - n[i] - ds) * (q[i] - q[i-1]) / (n[i] - n[i-1]));
+			if(q[i-1] < qp && qp < q[i+1]) q[i] = qp;
+			else q[i] = q[i] + ds * (q[i+ds] - q[i]) / (n[i+ds] - n[i]);
+			n[i] += ds;
+		}
+	}
+}
+
+/**
+ * @return the current estimate of the quantile, 0 if no sample has been added
+ */
+double p2_quantile::estimate() const {
+	if(count == 0) return 0;
+	if(count < 5){
+		//nearest rank on the sorted samples
+		int rank = (int)(p * (count - 1) + 0.5);
+		return q[rank];
+	}
+	return q[2];
+}
+
+/**
+ * Constructor for the temperature statistics
+ * @param alpha EWMA smoothing factor between 0 and 1, larger values follow the input faster
+ * @param window number of samples in each percentile window (tumbling window)
+ */
+temperature_stats::temperature_stats(double alpha, unsigned int window) {
+	this->alpha = alpha;
+	this->window = (window > 0) ? window : 1;
+	this->current[P50] = p2_quantile(0.50);
+	this->current[P90] = p2_quantile(0.90);
+	this->current[P99] = p2_quantile(0.99);
+	//alarms are disabled until thresholds are set
+	this->lowThreshold = -HUGE_VALF;
+	this->highThreshold = HUGE_VALF;
+	this->hysteresis = 0;
+	this->maxRate = HUGE_VALF;
+	this->reset();
+}
+
+/**
+ * Clear all statistics and alarms. Thresholds and rate limit are kept.
+ */
+void temperature_stats::reset(){
+	this->count = 0;
+	this->last = this->minimum = this->maximum = 0;
+	this->ewma = this->mean = this->m2 = 0;
+	this->rate = this->ewmaRate = 0;
+	this->lastNs = 0;
+	for(int i=0; i<PERCENTILES; i++){
+		this->current[i].reset();
+		this->published[i] = 0;
+	}
+	this->windowCount = 0;
+	this->windowComplete = false;
+	this->active = ALARM_NONE;
+}
+
+/**
+ * Set the threshold alarms. An alarm is raised when the temperature crosses a threshold and is
+ * only cleared once the temperature is back inside by more than the hysteresis.
+ * @param low the low threshold in °C
+ * @param high the high threshold in °C
+ * @param hysteresis the hysteresis in °C
+ */
+void temperature_stats::setThresholds(float low, float high, float hysteresis){
+	this->lowThreshold = low;
+	this->highThreshold = high;
+	this->hysteresis = hysteresis;
+}
+
+/**
+ * Set the rate of change alarm
+ * @param degreesPerMinute the largest allowed change of the smoothed rate in °C per minute
+ */
+void temperature_stats::setRateLimit(float degreesPerMinute){
+	this->maxRate = degreesPerMinute;
+}
+
+/**
+ * Fold a new sample into the statistics
+ * @param temperature the temperature in °C
+ * @param monotonicNs the time of the sample on the host monotonic clock
+ * @return the alarms that were raised by this sample (see ALARM), 0 if none
+ */
+unsigned int temperature_stats::addSample(float temperature, int64_t monotonicNs){
+
+	if(count == 0){
+		minimum = maximum = temperature;
+		ewma = temperature;
+	}
+	else{
+		if(temperature < minimum) minimum = temperature;
+		if(temperature > maximum) maximum = temperature;
+		ewma += alpha * (temperature - ewma);
+
+		int64_t dt = monotonicNs - lastNs;
+		if(dt > 0){
+			rate = (temperature - last) * 60e9 / dt;
+			//the sensor resolution is 0.25°C, so the raw rate is noisy and is smoothed as well
+			ewmaRate = (count == 1) ? rate : ewmaRate + alpha * (rate - ewmaRate);
+		}
+	}
+
+	//Welford's algorithm, numerically stable for long runs
+	count++;
+	double delta = temperature - mean;
+	mean += delta / count;
+	m2 += delta * (temperature - mean);
+
+	for(int i=0; i<PERCENTILES; i++) current[i].add(temperature);
+	if(++windowCount >= window){
+		for(int i=0; i<PERCENTILES; i++){
+			published[i] = current[i].estimate();
+			current[i].reset();
+		}
+		windowCount = 0;
+		windowComplete = true;
+	}
+
+	last = temperature;
+	lastNs = monotonicNs;
+
+	unsigned int previous = active;
+	this->updateAlarms();
+	return active & ~previous;
+}
+
+void temperature_stats::updateAlarms(){
+	if(last > highThreshold) active |= ALARM_HIGH;
+	else if(last < highThreshold - hysteresis) active &= ~ALARM_HIGH;
+
+	if(last < lowThreshold) active |= ALARM_LOW;
+	else if(last > lowThreshold + hysteresis) active &= ~ALARM_LOW;
+
+	if(fabs(ewmaRate) > maxRate) active |= ALARM_RATE;
+	else active &= ~ALARM_RATE;
+}
+
+/**
+ * @return the sample variance, 0 with fewer than two samples
+ */
+double temperature_stats::getVariance() const {
+	return (count > 1) ? m2 / (count - 1) : 0;
+}
+
+double temperature_stats::getStdDev() const {
+	return sqrt(this->getVariance());
+}
+
+/**
+ * Percentiles are reported for the last completed window. Until the first window completes
+ * the estimate of the running window is returned.
+ * @param which the percentile to return
+ */
+double temperature_stats::getPercentile(PERCENTILE which) const {
+	if(windowComplete) return published[which];
+	return current[which].estimate();
+}
+
+} /* namespace i2c */
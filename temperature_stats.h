@@ -0,0 +1,98 @@
+/*
+ * temperature_stats.h
+ *
+ * Streaming statistics for the DS3231 temperature sensor. Samples are folded into
+ * running estimates as they arrive, no history is kept: memory use is constant and
+ * each sample costs O(1).
+ */
+
+#ifndef TEMPERATURE_STATS_H_
+#define TEMPERATURE_STATS_H_
+
+#include <stdint.h>
+
+namespace i2c {
+
+/**
+ * @class p2_quantile
+ * @brief P-square quantile estimator (Jain & Chlamtac, 1985). Tracks a single quantile
+ * with five markers instead of storing the samples.
+ */
+class p2_quantile {
+private:
+	double p;
+	double q[5];        //marker heights
+	double n[5];        //actual marker positions
+	double np[5];       //desired marker positions
+	double dn[5];       //increments of the desired positions
+	unsigned int count;
+public:
+	p2_quantile(double p = 0.5);
+	void reset();
+	void add(double x);
+	double estimate() const;
+	unsigned int samples() const { return count; }
+};
+
+/**
+ * @class temperature_stats
+ * @brief Incremental temperature statistics with threshold and rate of change alarms
+ */
+class temperature_stats {
+public:
+	enum ALARM {
+		ALARM_NONE = 0x00,
+		ALARM_HIGH = 0x01,	//above the high threshold
+		ALARM_LOW  = 0x02,	//below the low threshold
+		ALARM_RATE = 0x04	//changing faster than the rate limit
+	};
+
+	//percentiles reported for the last completed window
+	enum PERCENTILE { P50, P90, P99, PERCENTILES };
+
+private:
+	double alpha;                  //EWMA smoothing factor
+	unsigned int window;           //samples per percentile window
+
+	unsigned long count;
+	float last, minimum, maximum;
+	double ewma;
+	double mean, m2;               //Welford running mean and sum of squared deviations
+	double rate, ewmaRate;         //°C per minute
+	int64_t lastNs;
+
+	p2_quantile current[PERCENTILES];
+	double published[PERCENTILES];
+	unsigned int windowCount;
+	bool windowComplete;
+
+	float highThreshold, lowThreshold, hysteresis, maxRate;
+	unsigned int active;           //currently raised alarms
+
+	void updateAlarms();
+
+public:
+	temperature_stats(double alpha = 0.1, unsigned int window = 64);
+
+	void setThresholds(float low, float high, float hysteresis = 0.5f);
+	void setRateLimit(float degreesPerMinute);
+
+	unsigned int addSample(float temperature, int64_t monotonicNs);
+	void reset();
+
+	unsigned long samples() const { return count; }
+	float getLast() const { return last; }
+	float getMin() const { return minimum; }
+	float getMax() const { return maximum; }
+	double getEwma() const { return ewma; }
+	double getMean() const { return mean; }
+	double getVariance() const;
+	double getStdDev() const;
+	double getRate() const { return ewmaRate; }
+	double getPercentile(PERCENTILE which) const;
+	unsigned int getAlarms() const { return active; }
+};
+
+} /* namespace i2c */
+
+#endif /* TEMPERATURE_STATS_H_ */